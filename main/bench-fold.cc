@@ -0,0 +1,66 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace viltrum;
+
+// Compares the lazy folds (stacked multiarray_folded views) with the eager fold kernels that Region and Polynomial use,
+// for the evaluation of the approximation at a point and the integral, with a Boole rule.
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (auto xi : x) r*=std::cos(3*xi*xi);
+		return r;
+	}
+};
+
+template<typename MA, typename Q, std::size_t DIM>
+double lazy_at(const MA& ma, const Q& q, const std::array<double,DIM>& pos) {
+	auto f = [&] (const auto& v) { return q.at(pos[DIM - MA::dimensions],v); };
+	if constexpr (MA::dimensions > 1) return lazy_at(ma.fold(f),q,pos);
+	else return ma.fold(f).value();
+}
+
+template<typename MA, typename Q, std::size_t DIM>
+double eager_at(const MA& ma, const Q& q, const std::array<double,DIM>& pos) {
+	auto f = [&] (const auto& v) { return q.at(pos[DIM - MA::dimensions],v); };
+	if constexpr (MA::dimensions > 1) return eager_at(ma.fold_eager(f),q,pos);
+	else return ma.fold_eager(f);
+}
+
+template<typename F>
+double seconds(const F& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<std::size_t DIM>
+void bench(std::size_t n) {
+	auto r = region(Function(),boole,range_primary<DIM,double>());
+	const auto& ma = r.samples();
+	double lazy = 0, eager = 0;
+	std::array<double,DIM> pos;
+	double tlazy = seconds([&] { for (std::size_t i = 0; i<n; ++i) { pos.fill(double(i%1000)/1000.0); lazy += lazy_at(ma,boole,pos); } });
+	double teager = seconds([&] { for (std::size_t i = 0; i<n; ++i) { pos.fill(double(i%1000)/1000.0); eager += eager_at(ma,boole,pos); } });
+	std::cout<<"Boole "<<DIM<<"D approximation_at\t"<<std::setprecision(3)<<tlazy<<"s lazy vs "<<teager<<"s eager\t"
+		<<((lazy==eager)?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	lazy = 0; eager = 0;
+	tlazy = seconds([&] { for (std::size_t i = 0; i<n; ++i) lazy += detail::fold_all(multiarray_constref<std::decay_t<decltype(ma)>>(ma),boole); });
+	teager = seconds([&] { for (std::size_t i = 0; i<n; ++i) eager += ma.fold_all(boole); });
+	std::cout<<"Boole "<<DIM<<"D fold_all        \t"<<std::setprecision(3)<<tlazy<<"s lazy vs "<<teager<<"s eager\t"
+		<<((lazy==eager)?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	bench<1>(1000000);
+	bench<2>(200000);
+	bench<3>(40000);
+	bench<4>(8000);
+}
@@ -0,0 +1,57 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace viltrum;
+
+// Throughput of region creation and splitting. It is compiled twice (see CMakeLists.txt): with the default inline storage
+// for small multiarrays and with VILTRUM_MULTIARRAY_INLINE_BYTES=0, which forces dynamic memory for every region.
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (auto xi : x) r*=(Float(1)+xi*xi);
+		return r;
+	}
+};
+
+template<std::size_t DIM, typename Q>
+void bench(const char* name, const Q& q) {
+	//Roughly the same number of function evaluations for all the rules and dimensions
+	std::size_t samples = 1; for (std::size_t i = 0; i<DIM; ++i) samples*=Q::samples;
+	std::size_t n = std::max(std::size_t(4),std::size_t(1000000)/samples);
+	Function f;
+	double checksum = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i<n; ++i) {
+		std::array<double,DIM> a, b; a.fill(0); b.fill(1); a[0] = double(i)/double(n);
+		checksum += region(f,q,a,b).integral();
+	}
+	double tcreate = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	auto r = region(f,q,range_primary<DIM,double>());
+	start = std::chrono::steady_clock::now();
+	for (std::size_t i = 0; i<n; ++i) checksum += r.split(f,i%DIM).front().integral();
+	double tsplit = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout<<name<<"\t"<<DIM<<"D\t"<<(std::decay_t<decltype(r.samples())>::inline_storage?"inline":"heap  ")<<"\t"
+		<<std::setprecision(3)<<std::setw(10)<<double(n)/tcreate<<" creations/s\t"
+		<<std::setw(10)<<double(n)/tsplit<<" splits/s\t(checksum "<<checksum<<")"<<std::endl;
+}
+
+template<typename Q>
+void bench_all(const char* name, const Q& q) {
+	bench<1>(name,q); bench<2>(name,q); bench<3>(name,q);
+	bench<4>(name,q); bench<5>(name,q); bench<6>(name,q);
+}
+
+int main(int argc, char **argv) {
+	bench_all("Trapezoidal",trapezoidal);
+	bench_all("Simpson    ",simpson);
+	bench_all("Boole      ",boole);
+}
@@ -0,0 +1,53 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+//Queries the integral after every step, as convergence plots do
+template<typename Query>
+void bench(const char* name, unsigned long iterations, const Query& query) {
+	auto stepper = stepper_adaptive(nested(simpson,trapezoidal));
+	auto heap = stepper.init(Function(),range_primary<2,double>());
+	double checksum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i<iterations; ++i) {
+		stepper.step(Function(),range_primary<2,double>(),heap);
+		checksum += query(stepper,heap);
+	}
+	auto end = std::chrono::steady_clock::now();
+	std::cout<<name<<"\t"<<std::setprecision(15)<<query(stepper,heap)<<"\t"<<checksum/double(iterations)<<"\t"
+		<<std::chrono::duration<double,std::milli>(end-start).count()<<" ms"<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	unsigned long iterations = 20000;
+	auto walk = [] (const auto& stepper, const auto& heap) {
+		return stepper.integral(Function(),range_primary<2,double>(),heap.regions());
+	};
+	auto running = [] (const auto& stepper, const auto& heap) {
+		return stepper.integral(Function(),range_primary<2,double>(),heap);
+	};
+	bench("Walk all regions",iterations,walk);
+	bench("Running total   ",iterations,running);
+
+	auto stepper = stepper_adaptive(nested(simpson,trapezoidal));
+	auto heap = stepper.init(Function(),range_primary<2,double>());
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(Function(),range_primary<2,double>(),heap);
+	CompensatedSum<double> integral, error;
+	for (const auto& r : heap) { integral += r.integral(); error += std::get<0>(r.extra()); }
+	std::cout<<"Running integral vs compensated sum of regions\t"<<std::setprecision(3)<<std::abs(heap.integral()-integral.value())<<std::endl;
+	std::cout<<"Running error vs compensated sum of regions   \t"<<std::setprecision(3)<<std::abs(heap.error()-error.value())/error.value()<<" (relative)"<<std::endl;
+}
@@ -0,0 +1,60 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace viltrum;
+
+// Compares Region::approximation_at with the flat tensor-Horner evaluator (TensorHorner) that the control variates
+// integrators use for the residual, point by point and in batches, and the resulting control variates integration.
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (auto xi : x) r*=std::cos(3*xi*xi);
+		return r;
+	}
+};
+
+template<typename F>
+double seconds(const F& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<std::size_t DIM, typename Q>
+void bench(const char* name, const Q& q, std::size_t n) {
+	auto r = region(Function(),q,range_primary<DIM,double>());
+	auto horner = tensor_horner(r.polynomial());
+	std::vector<std::array<double,DIM>> points(n);
+	for (std::size_t i = 0; i<n; ++i)
+		for (std::size_t d = 0; d<DIM; ++d) points[i][d] = double((i*(2*d+3))%1000)/1000.0;
+	double sregion = 0, shorner = 0, error = 0;
+	std::vector<double> values;
+	double tregion = seconds([&] { for (const auto& x : points) sregion += r.approximation_at(x); });
+	double thorner = seconds([&] { for (const auto& x : points) shorner += horner(x); });
+	double tbatch = seconds([&] { evaluate_batch(horner,points,values); });
+	for (std::size_t i = 0; i<n; ++i) error = std::max(error,std::abs(values[i] - r.approximation_at(points[i])));
+	std::cout<<name<<" "<<DIM<<"D\t"<<std::setprecision(3)<<tregion<<"s region vs "<<thorner<<"s horner ("
+		<<tbatch<<"s batch)\tx"<<tregion/thorner<<"\t"<<((error<1.e-12 && std::abs(sregion - shorner)<1.e-12*double(n))?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	bench<1>("Boole  ",boole,1000000);
+	bench<2>("Boole  ",boole,1000000);
+	bench<3>("Boole  ",boole,200000);
+	bench<4>("Simpson",simpson,200000);
+	bench<3>("Simpson",simpson,1000000);
+
+	//Full control variates integration, which mostly evaluates the residual
+	Function f;
+	double t = seconds([&] {
+		std::cout<<"Control variates 3D\t"<<std::setprecision(6)
+			<<integrator_adaptive_control_variates(nested(simpson,trapezoidal),100,200000,std::size_t(1)).integrate(f,range_primary<3,double>());
+	});
+	std::cout<<"\t"<<std::setprecision(3)<<t<<"s"<<std::endl;
+}
@@ -29,6 +29,15 @@ int main(int argc, char **argv) {
 		      .fold([&] (const auto& v) { return simpson.at(0.3,v);})
 		      .fold([&] (const auto& v) { return simpson.at(0.3,v);})
 		      <<std::endl;
+	std::cout<<"Eager:"<<std::endl;
+	std::cout<<ma.fold_eager(sum)<<std::endl;
+	std::cout<<ma.fold_eager(sum,1)<<std::endl;
+	std::cout<<ma.fold_eager(sum).fold_eager(sum)<<std::endl;
+	std::cout<<"Simpson at 0.3,0.3,0.3 = "<<
+		fevals.fold_eager([&] (const auto& v) { return simpson.at(0.3,v);})
+		      .fold_eager([&] (const auto& v) { return simpson.at(0.3,v);})
+		      .fold_eager([&] (const auto& v) { return simpson.at(0.3,v);})
+		      <<std::endl;
 	
 	return 0;
 }
@@ -0,0 +1,44 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (auto xi : x) r*=std::cos(8*xi*xi);
+		return r;
+	}
+};
+
+template<std::size_t DIM, typename Stepper>
+double integrate_steps(const Stepper& stepper, unsigned long iterations) {
+	return integrator_stepper(stepper,iterations).integrate(Function(),range_primary<DIM,double>());
+}
+
+template<std::size_t DIM>
+void test(const char* name, unsigned long iterations) {
+	std::cout<<name<<std::endl;
+	double sequential = integrate_steps<DIM>(stepper_adaptive(nested(simpson,trapezoidal)),iterations);
+	double parallel1  = integrate_steps<DIM>(stepper_adaptive_parallel(nested(simpson,trapezoidal),1,4),iterations);
+	std::cout<<"  Sequential         "<<std::setprecision(12)<<sequential<<std::endl;
+	std::cout<<"  Parallel K=1       "<<std::setprecision(12)<<parallel1<<"\t"<<((sequential==parallel1)?"[SAME]":"[DIFFERENT]")<<std::endl;
+	for (std::size_t k : {4, 16}) {
+		double reference = integrate_steps<DIM>(stepper_adaptive_parallel(nested(simpson,trapezoidal),k,1),iterations/k);
+		std::cout<<"  Parallel K="<<std::setw(2)<<k<<" 1 thr "<<std::setprecision(12)<<reference<<std::endl;
+		for (std::size_t threads : {2, 8}) {
+			double p = integrate_steps<DIM>(stepper_adaptive_parallel(nested(simpson,trapezoidal),k,threads),iterations/k);
+			std::cout<<"  Parallel K="<<std::setw(2)<<k<<" "<<threads<<" thr "<<std::setprecision(12)<<p<<"\t"<<((reference==p)?"[SAME]":"[DIFFERENT]")<<std::endl;
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	test<1>("1D",64);
+	test<2>("2D",256);
+	test<3>("3D",512);
+}
@@ -0,0 +1,46 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+template<typename Integrator, std::size_t DIM>
+double timed(const Integrator& integrator, const Range<double,DIM>& range, double& seconds) {
+	auto start = std::chrono::steady_clock::now();
+	double sol = integrator.integrate(Function(),range);
+	seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return sol;
+}
+
+template<std::size_t DIM, typename N>
+void test(const char* name, const N& nested, unsigned long iterations) {
+	double ts, tp;
+	double is = timed(integrator_adaptive_iterations(nested,iterations),range_primary<DIM,double>(),ts);
+	double ip = timed(integrator_adaptive_pool_iterations(nested,iterations),range_primary<DIM,double>(),tp);
+	std::cout<<name<<"\t"<<std::setprecision(12)<<is<<"\t"<<ip<<"\t"<<((is==ip)?"[SAME]":"[DIFFERENT]")
+		<<"\t"<<std::setprecision(3)<<ts<<"s vs "<<tp<<"s"<<std::endl;
+
+	std::vector<double> bs(64,0.0), bp(64,0.0);
+	integrate_bins(integrator_bins_adaptive(nested,iterations),bs,Function(),range_primary<DIM,double>());
+	integrate_bins(integrator_bins_adaptive_pool(nested,iterations),bp,Function(),range_primary<DIM,double>());
+	std::cout<<name<<"\tBins\t\t\t\t"<<((bs==bp)?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	test<1>("Simpson-Trapezoidal 1D",nested(simpson,trapezoidal),100000);
+	test<2>("Simpson-Trapezoidal 2D",nested(simpson,trapezoidal),100000);
+	test<3>("Simpson-Trapezoidal 3D",nested(simpson,trapezoidal),100000);
+	test<3>("Boole-Simpson 3D      ",nested(boole,simpson),20000);
+}
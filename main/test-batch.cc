@@ -0,0 +1,57 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+3)*x[i]*x[i]);
+		return r;
+	}
+};
+
+class FunctionCount : public Function {
+	mutable unsigned long calls = 0;
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		++calls; return Function::operator()(x);
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+// Same function, but also offers the batched interface. Counts calls and evaluated samples.
+class FunctionBatch : public Function {
+	mutable unsigned long calls = 0, samples = 0;
+public:
+    template<typename Float, std::size_t DIM>
+	void evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<Float>& values) const {
+		++calls; samples+=points.size();
+		for (std::size_t i = 0; i<points.size(); ++i) values[i] = (*this)(points[i]);
+	}
+	unsigned long batch_calls() const { return calls; }
+	unsigned long batch_samples() const { return samples; }
+};
+
+template<std::size_t DIM, typename N>
+void test(const char* name, const N& nested, unsigned long iterations) {
+	FunctionCount scalar;
+	FunctionBatch batch;
+	double is = integrator_adaptive_iterations(nested,iterations).integrate(scalar,range_primary<DIM,double>());
+	double ib = integrator_adaptive_iterations(nested,iterations).integrate(batch,range_primary<DIM,double>());
+	std::cout<<name<<"\t"<<std::setprecision(12)<<is<<"\t"<<ib<<"\t"<<((is==ib)?"[SAME]":"[DIFFERENT]")
+		<<"\tScalar calls "<<scalar.evaluations()<<"\tBatch calls "<<batch.batch_calls()<<" ("<<batch.batch_samples()<<" samples)"<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	test<1>("Simpson-Trapezoidal 1D",nested(simpson,trapezoidal),32);
+	test<2>("Simpson-Trapezoidal 2D",nested(simpson,trapezoidal),32);
+	test<3>("Simpson-Trapezoidal 3D",nested(simpson,trapezoidal),32);
+	test<2>("Boole-Simpson 2D      ",nested(boole,simpson),32);
+	test<3>("Boole-Simpson 3D      ",nested(boole,simpson),32);
+}
@@ -0,0 +1,54 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+template<typename Integrator>
+std::vector<std::vector<double>> image(const Integrator& integrator) {
+	std::vector<std::vector<double>> bins(32,std::vector<double>(48,0.0));
+	integrate_bins(integrator,bins,Function(),range_primary<3,double>());
+	return bins;
+}
+
+double total(const std::vector<std::vector<double>>& bins) {
+	double t = 0; std::size_t n = 0;
+	for (const auto& row : bins) for (double b : row) { t += b; ++n; }
+	return t/double(n);
+}
+
+int main(int argc, char **argv) {
+	auto regions = region_generator(nested(simpson,trapezoidal),error_single_dimension_standard(),2000).compute_regions(Function(),range_primary<3,double>());
+	std::array<std::size_t,2> resolution{48,32};
+	auto bins_of = [&] (std::size_t i) { return pixels_in_region(regions[i],resolution,range_primary<3,double>()); };
+	auto serial = bin_index(resolution,regions.size(),bins_of);
+	std::size_t entries = 0, max_entries = 0;
+	for (std::size_t b = 0; b<serial.size(); ++b) { entries += serial[b].size(); max_entries = std::max(max_entries,serial[b].size()); }
+	std::cout<<"Regions "<<regions.size()<<" - Bins "<<serial.size()<<" - Entries "<<entries<<" (max "<<max_entries<<" per bin)"<<std::endl;
+	for (std::size_t threads : {2, 8}) {
+		auto parallel = bin_index(resolution,regions.size(),bins_of,threads);
+		bool same = (parallel.size() == serial.size());
+		for (std::size_t b = 0; same && (b<serial.size()); ++b)
+			same = std::equal(serial[b].begin(),serial[b].end(),parallel[b].begin(),parallel[b].end());
+		std::cout<<"Index, serial vs "<<threads<<" threads\t"<<(same?"[SAME]":"[DIFFERENT]")<<std::endl;
+	}
+
+	std::cout<<"Stratified all CV   \t"<<std::setprecision(10)<<total(image(integrator_optimized_adaptive_stratified_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),2000,16,std::size_t(0))))<<std::endl;
+	std::cout<<"Stratified pixel CV \t"<<std::setprecision(10)<<total(image(integrator_stratified_pixel_control_variates(
+		region_generator(nested(simpson,trapezoidal),error_single_dimension_standard(),2000),AlphaOptimized(),FunctionSampler(),std::mt19937_64(0),16)))<<std::endl;
+	std::cout<<"Stepper CV          \t"<<std::setprecision(10)<<total(image(integrator_bins_stepper(
+		stepper_bins_adaptive_stratified_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),2000ul,std::size_t(0),std::size_t(1)),16)))<<std::endl;
+	std::cout<<"Stepper CV precalc  \t"<<std::setprecision(10)<<total(image(integrator_bins_stepper(
+		stepper_bins_adaptive_stratified_control_variates_precalculate(nested(simpson,trapezoidal),2000ul,std::size_t(0),std::size_t(1)),16)))<<std::endl;
+}
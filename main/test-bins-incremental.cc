@@ -0,0 +1,80 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+
+using namespace viltrum;
+
+template<typename F>
+double seconds(const F& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Bins>
+double difference(const Bins& a, const Bins& b, const std::array<std::size_t,2>& resolution) {
+	double d = 0;
+	for (auto pos : multidimensional_range(resolution)) d = std::max(d,std::abs(a[pos] - b[pos]));
+	return d;
+}
+
+int main(int argc, char **argv) {
+	auto f = [] (const std::array<double,3>& x) { return ((x[0]*x[0] + x[1]*x[1] < 0.5)?std::sin(4.0*x[0]):1.0)*std::exp(-x[2]); };
+	auto range = range_primary<3,double>();
+	std::array<std::size_t,2> resolution{32,32};
+	auto regular = stepper_bins_adaptive(nested(simpson,trapezoidal));
+	auto incremental = stepper_bins_adaptive_incremental(nested(simpson,trapezoidal));
+
+	//Every intermediate image is the one rebuilt from all the regions
+	auto data = incremental.init(resolution,f,range);
+	double worst = 0;
+	for (int i = 0; i<2000; ++i) {
+		incremental.step(resolution,f,range,data);
+		if (i%100 == 99) {
+			vector_dimensions<double,2> a(resolution), b(resolution);
+			incremental.integral(a,resolution,f,range,data);
+			regular.integral(b,resolution,f,range,data.regions);
+			worst = std::max(worst,difference(a,b,resolution));
+		}
+	}
+	std::cout<<"Intermediate images\t"<<((worst<1.e-12)?"[SAME]":"[DIFFERENT]")<<"\t(difference "<<worst<<")"<<std::endl;
+
+	vector_dimensions<double,2> a(resolution), b(resolution);
+	integrator_bins_stepper(stepper_bins_adaptive_incremental(nested(simpson,trapezoidal)),5000).integrate(a,resolution,f,range);
+	integrator_bins_adaptive(nested(simpson,trapezoidal),5000).integrate(b,resolution,f,range);
+	std::cout<<"Final image\t\t"<<((difference(a,b,resolution)<1.e-12)?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	//A preview every 50 iterations, rebuilding all the regions or keeping the bins updated
+	unsigned long iterations = 5000, every = 50, previews = 0;
+	double trebuild = seconds([&] {
+		auto regions = regular.init(resolution,f,range);
+		for (unsigned long i = 0; i<iterations; ++i) {
+			regular.step(resolution,f,range,regions);
+			if ((i+1)%every == 0) { vector_dimensions<double,2> bins(resolution); regular.integral(bins,resolution,f,range,regions); }
+		}
+	});
+	double tincremental = seconds([&] {
+		vector_dimensions<double,2> bins(resolution);
+		integrate_bins_stepper_progression("Incremental",incremental,iterations,bins,resolution,f,range,
+			[&previews] (const vector_dimensions<double,2>&, unsigned long) { ++previews; },every);
+	});
+	std::cout<<"Previews ("<<previews<<")\t\t"<<std::setprecision(3)<<trebuild<<"s rebuilding vs "<<tincremental<<"s incremental"<<std::endl;
+
+	//The integral of stepper_bins_adaptive adds to the bins: previews must not accumulate into the final image
+	vector_dimensions<double,2> previewed(resolution), plain(resolution);
+	integrate_bins_stepper_progression("Regular",regular,2000,previewed,resolution,f,range,
+		[] (const vector_dimensions<double,2>&, unsigned long) { },100);
+	integrator_bins_adaptive(nested(simpson,trapezoidal),2000).integrate(plain,resolution,f,range);
+	std::cout<<"Previews of regular\t"<<((difference(previewed,plain,resolution)<1.e-12)?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	//Resuming splats the regions again
+	save_checkpoint("test-bins-incremental.tmp",incremental,data);
+	unsigned long done;
+	auto loaded = load_bins_checkpoint("test-bins-incremental.tmp",incremental,resolution,f,range,done);
+	std::remove("test-bins-incremental.tmp");
+	incremental.integral(a,resolution,f,range,data);
+	incremental.integral(b,resolution,f,range,loaded);
+	std::cout<<"Checkpoint\t\t"<<((difference(a,b,resolution)<1.e-12)?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,50 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+template<typename Integrator>
+std::vector<std::vector<double>> image(const Integrator& integrator) {
+	std::vector<std::vector<double>> bins(48,std::vector<double>(64,0.0));
+	integrate_bins(integrator,bins,Function(),range_primary<3,double>());
+	return bins;
+}
+
+int main(int argc, char **argv) {
+	auto serial = image(integrator_bins_per_bin(integrator_adaptive_iterations(nested(simpson,trapezoidal),20)));
+	auto parallel = image(integrator_bins_per_bin_parallel(integrator_adaptive_iterations(nested(simpson,trapezoidal),20),0,8));
+	std::cout<<"Adaptive per bin, serial vs 8 threads       \t"<<((serial==parallel)?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	auto mc1 = image(integrator_bins_per_bin_parallel(integrator_monte_carlo_uniform(16),7,1));
+	for (std::size_t threads : {2, 8}) {
+		auto mc = image(integrator_bins_per_bin_parallel(integrator_monte_carlo_uniform(16),7,threads));
+		std::cout<<"Monte Carlo per bin, 1 vs "<<threads<<" threads         \t"<<((mc1==mc)?"[SAME]":"[DIFFERENT]")<<std::endl;
+	}
+	auto mcseed = image(integrator_bins_per_bin_parallel(integrator_monte_carlo_uniform(16),8,1));
+	std::cout<<"Monte Carlo per bin, different seed         \t"<<((mc1==mcseed)?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	auto st1 = image(integrator_bins_stepper(stepper_bins_per_bin_parallel(stepper_monte_carlo_uniform(),7,1),16));
+	for (std::size_t threads : {2, 8}) {
+		auto st = image(integrator_bins_stepper(stepper_bins_per_bin_parallel(stepper_monte_carlo_uniform(),7,threads),16));
+		std::cout<<"Monte Carlo stepper per bin, 1 vs "<<threads<<" threads \t"<<((st1==st)?"[SAME]":"[DIFFERENT]")<<std::endl;
+	}
+
+	//The integrand does not change along the bins, so two tiles with the same residual (and sampler) stream would get exactly the same value
+	auto flat = [] (const std::array<double,2>& x) { return std::cos(5.0*x[1]*x[1]); };
+	std::vector<double> cv(2,0.0);
+	integrate_bins(integrator_bins_per_bin_parallel(integrator_adaptive_control_variates(nested(simpson,trapezoidal),4,64,std::size_t(3)),7,2,1),
+		cv,flat,range_primary<2,double>());
+	std::cout<<"Control variates per bin, two tiles         \t"<<((cv[0]==cv[1])?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,71 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+//Integral on each bin known analytically: separable in x, y and a third dimension
+class Function {
+public:
+	double operator()(const std::array<double,3>& x) const {
+		return std::cos(6.0*x[0])*(1.0 + x[1]*x[1])*std::exp(-x[2]);
+	}
+	static double bin(double x0, double x1, double y0, double y1) {
+		return ((std::sin(6.0*x1) - std::sin(6.0*x0))/6.0)*((y1 - y0) + (y1*y1*y1 - y0*y0*y0)/3.0)*(1.0 - std::exp(-1.0));
+	}
+};
+
+template<typename Bins>
+double error(const Bins& bins, const std::array<std::size_t,2>& resolution) {
+	double e = 0, n = double(resolution[0]*resolution[1]);
+	for (auto pos : multidimensional_range(resolution)) {
+		double exact = n*Function::bin(pos[0]/double(resolution[0]),(pos[0]+1)/double(resolution[0]),
+		                                pos[1]/double(resolution[1]),(pos[1]+1)/double(resolution[1]));
+		e = std::max(e,std::abs(bins[pos] - exact));
+	}
+	return e;
+}
+
+template<typename A, typename B>
+double difference(const A& a, const B& b, const std::array<std::size_t,2>& resolution) {
+	double d = 0;
+	for (auto pos : multidimensional_range(resolution)) d = std::max(d,std::abs(a[pos] - b[pos]));
+	return d;
+}
+
+int main(int argc, char **argv) {
+	std::cout<<std::scientific<<std::setprecision(3);
+	Function f;
+	auto range = range_primary<3,double>();
+	std::array<std::size_t,2> resolution{50,37}, tile{16,16};
+
+	//Bins integrated independently: the same result with or without tiles (tiles at the border are smaller)
+	auto per_bin = integrator_bins_per_bin(integrator_quadrature(boole));
+	vector_dimensions<double,2> whole(resolution), tiled(resolution);
+	per_bin.integrate(whole,resolution,f,range);
+	integrate_bins_tiled(per_bin,tile,tiled,resolution,f,range);
+	std::cout<<"Per bin quadrature\t\t"<<((difference(whole,tiled,resolution)<1.e-12)?"[SAME]":"[DIFFERENT]")
+		<<"\t(error "<<error(tiled,resolution)<<")"<<std::endl;
+
+	//Streamed to a file, a tile at a time
+	{
+		BinsFile<double,2> file("test-bins-tiled.tmp",resolution);
+		integrate_bins_tiled(per_bin,tile,file,resolution,f,range);
+		std::cout<<"Bins file\t\t\t"<<((difference(tiled,file,resolution)==0)?"[SAME]":"[DIFFERENT]")<<std::endl;
+	}
+	std::remove("test-bins-tiled.tmp");
+
+	//Adaptive integrators refine each tile on its own
+	vector_dimensions<double,2> adaptive(resolution), adaptive_tiled(resolution);
+	integrator_bins_adaptive(nested(simpson,trapezoidal),2000).integrate(adaptive,resolution,f,range);
+	integrate_bins_tiled(integrator_bins_adaptive(nested(simpson,trapezoidal),2000/12),tile,adaptive_tiled,resolution,f,range);
+	std::cout<<"Adaptive\t\t\terror "<<error(adaptive,resolution)<<" whole, "<<error(adaptive_tiled,resolution)<<" in 12 tiles"<<std::endl;
+
+	vector_dimensions<double,2> cv(resolution), cv_tiled(resolution);
+	integrator_bins_stepper(stepper_bins_adaptive_control_variates(nested(simpson,trapezoidal),1000,std::size_t(1),std::size_t(2)),1000+20000)
+		.integrate(cv,resolution,f,range);
+	integrate_bins_tiled(integrator_bins_stepper(stepper_bins_adaptive_control_variates(nested(simpson,trapezoidal),1000/12,std::size_t(1),std::size_t(2)),(1000+20000)/12),
+		tile,cv_tiled,resolution,f,range);
+	std::cout<<"Control variates\t\terror "<<error(cv,resolution)<<" whole, "<<error(cv_tiled,resolution)<<" in 12 tiles"<<std::endl;
+}
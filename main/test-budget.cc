@@ -0,0 +1,55 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+	mutable unsigned long calls = 0;
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		++calls;
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+void print(const char* name, const BudgetReport& r) {
+	std::cout<<name<<"\tstop: "<<std::setw(11)<<to_string(r.stop)<<"\titerations "<<std::setw(6)<<r.iterations
+		<<"\tevaluations "<<std::setw(8)<<r.evaluations<<"\terror "<<std::setprecision(3)<<std::setw(9)<<r.error<<"\t"<<r.seconds<<" s"<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	auto stepper = stepper_adaptive(nested(simpson,trapezoidal));
+	BudgetReport report;
+
+	Function f;
+	double by_iterations = integrator_budget(stepper,budget().iterations(500)).integrate(f,range_primary<2,double>(),report);
+	print("Iterations ",report);
+	std::cout<<"  Same as integrator_adaptive_iterations\t"<<((by_iterations==integrator_adaptive_iterations(nested(simpson,trapezoidal),500).integrate(Function(),range_primary<2,double>()))?"[SAME]":"[DIFFERENT]")
+		<<"\n  Evaluations counted exactly\t\t\t"<<((report.evaluations==f.evaluations())?"[OK]":"[FAILED]")<<std::endl;
+
+	integrator_budget(stepper,budget().evaluations(10000)).integrate(Function(),range_primary<2,double>(),report);
+	print("Evaluations",report);
+	std::cout<<"  Within budget\t\t\t\t\t"<<((report.evaluations<=10000)?"[OK]":"[FAILED]")<<std::endl;
+
+	integrator_budget(stepper,budget().error(1.e-5)).integrate(Function(),range_primary<2,double>(),report);
+	print("Error      ",report);
+	std::cout<<"  Error reached\t\t\t\t\t"<<((report.error<=1.e-5)?"[OK]":"[FAILED]")<<std::endl;
+
+	integrator_budget(stepper_monte_carlo_uniform(std::size_t(0)),budget().seconds(0.05)).integrate(Function(),range_primary<2,double>(),report);
+	print("Time       ",report);
+
+	//Whatever comes first
+	integrator_budget(stepper,budget().seconds(10.0).evaluations(1000000).error(1.e-4)).integrate(Function(),range_primary<2,double>(),report);
+	print("Combined   ",report);
+
+	std::vector<std::vector<double>> bins(16,std::vector<double>(16,0.0));
+	auto integrator = integrator_bins_budget(stepper_bins_adaptive(nested(simpson,trapezoidal)),budget().error(1.e-5).seconds(10.0));
+	integrate_bins(integrator,bins,Function(),range_primary<2,double>());
+	print("Bins       ",integrator.last_report());
+}
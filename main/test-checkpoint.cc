@@ -0,0 +1,126 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <cmath>
+#include <cstdio>
+
+using namespace viltrum;
+
+class Function {
+	mutable unsigned long calls = 0;
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		++calls;
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+const char* filename = "test-checkpoint.tmp";
+
+//Steps the stepper for iterations, but through a checkpoint (to a stepper created with make_resumed) halfway
+template<typename Stepper, typename MakeResumed>
+void test(const char* name, const Stepper& stepper, const MakeResumed& make_resumed, unsigned long iterations) {
+	auto range = range_primary<2,double>();
+	Function f;
+	auto data = stepper.init(f,range);
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(f,range,data);
+	double uninterrupted = stepper.integral(f,range,data);
+
+	auto first = make_resumed(0);
+	auto first_data = first.init(f,range);
+	for (unsigned long i = 0; i<iterations/2; ++i) first.step(f,range,first_data);
+	save_checkpoint(filename,first,first_data,iterations/2);
+
+	auto second = make_resumed(1234); //Different seed: the state is restored from the checkpoint
+	unsigned long done, calls = f.evaluations();
+	auto second_data = load_checkpoint(filename,second,f,range,done);
+	bool evaluated = (f.evaluations() != calls);
+	for (unsigned long i = done; i<iterations; ++i) second.step(f,range,second_data);
+	double resumed = second.integral(f,range,second_data);
+
+	std::cout<<name<<"\t"<<uninterrupted<<"\t"<<resumed<<"\t"<<((uninterrupted==resumed)?"[SAME]":"[DIFFERENT]")
+		<<((evaluated)?" [EVALUATED ON LOAD]":"")<<std::endl;
+}
+
+template<typename Stepper, typename MakeResumed>
+void test_bins(const char* name, const Stepper& stepper, const MakeResumed& make_resumed, unsigned long iterations) {
+	auto range = range_primary<3,double>();
+	std::array<std::size_t,2> resolution{8,8};
+	Function f;
+	auto data = stepper.init(resolution,f,range);
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(resolution,f,range,data);
+	vector_dimensions<double,2> uninterrupted(resolution);
+	stepper.integral(uninterrupted,resolution,f,range,data);
+
+	auto first = make_resumed(0);
+	auto first_data = first.init(resolution,f,range);
+	for (unsigned long i = 0; i<iterations/2; ++i) first.step(resolution,f,range,first_data);
+	save_checkpoint(filename,first,first_data,iterations/2);
+
+	auto second = make_resumed(1234);
+	unsigned long done, calls = f.evaluations();
+	auto second_data = load_bins_checkpoint(filename,second,resolution,f,range,done);
+	bool evaluated = (f.evaluations() != calls);
+	for (unsigned long i = done; i<iterations; ++i) second.step(resolution,f,range,second_data);
+	vector_dimensions<double,2> resumed(resolution);
+	second.integral(resumed,resolution,f,range,second_data);
+
+	std::cout<<name<<"\t"<<((uninterrupted.raw_data()==resumed.raw_data())?"[SAME]":"[DIFFERENT]")
+		<<((evaluated)?" [EVALUATED ON LOAD]":"")<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	auto adaptive = [] (std::size_t) { return stepper_adaptive(nested(simpson,trapezoidal)); };
+	test("Adaptive               ",adaptive(0),adaptive,1000);
+	auto mc = [] (std::size_t seed) { return stepper_monte_carlo_uniform(seed); };
+	test("Monte Carlo            ",mc(0),mc,10000);
+	auto counter = [] (std::size_t seed) { return stepper_monte_carlo_counter(0); };
+	test("Monte Carlo counter    ",counter(0),counter,10000);
+	auto cv = [] (std::size_t seed) { return stepper_adaptive_control_variates(nested(simpson,trapezoidal),100,seed,seed+1); };
+	test("Control variates (MC phase)",cv(0),cv,1000);
+	test("Control variates (CV phase)",cv(0),cv,150);
+	auto cv_error = [] (std::size_t seed) {
+		return stepper_adaptive_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),
+			stepper_monte_carlo_uniform(seed),vector_sampler_error(error_single_dimension_standard(),seed+1),100); };
+	test("Control variates (alias)",cv_error(0),cv_error,1000);
+
+	auto bins_adaptive = [] (std::size_t) { return stepper_bins_adaptive(nested(simpson,trapezoidal)); };
+	test_bins("Bins adaptive          ",bins_adaptive(0),bins_adaptive,1000);
+	auto bins_mc = [] (std::size_t seed) { return stepper_bins_monte_carlo_uniform(seed); };
+	test_bins("Bins Monte Carlo       ",bins_mc(0),bins_mc,10000);
+	auto bins_counter = [] (std::size_t seed) { return stepper_bins_monte_carlo_counter(0); };
+	test_bins("Bins Monte Carlo counter",bins_counter(0),bins_counter,10000);
+	auto per_bin = [] (std::size_t seed) { return stepper_bins_per_bin(stepper_monte_carlo_uniform(seed)); };
+	test_bins("Bins per bin MC        ",per_bin(0),per_bin,100);
+	auto bins_cv = [] (std::size_t seed) {
+		return stepper_bins_adaptive_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),
+			stepper_bins_per_bin(stepper_monte_carlo_uniform(seed)),vector_sampler_uniform(seed+1),100); };
+	test_bins("Bins control variates  ",bins_cv(0),bins_cv,400);
+
+	//Checkpointed driver: interrupted after 300 iterations and resumed up to 1000
+	std::remove(filename);
+	auto range = range_primary<3,double>();
+	std::array<std::size_t,2> resolution{8,8};
+	vector_dimensions<double,2> reference(resolution), partial(resolution), driver(resolution);
+	integrator_bins_stepper(stepper_bins_monte_carlo_uniform(std::size_t(7)),1000).integrate(reference,resolution,Function(),range);
+	integrate_bins_stepper_checkpoint(filename,100,stepper_bins_monte_carlo_uniform(std::size_t(7)),300,partial,resolution,Function(),range);
+	integrate_bins_stepper_checkpoint(filename,100,stepper_bins_monte_carlo_uniform(std::size_t(99)),1000,driver,resolution,Function(),range);
+	std::cout<<"Checkpointed driver     \t"<<((reference.raw_data()==driver.raw_data())?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	//Wrong stepper type
+	bool rejected = false;
+	try { auto s = stepper_monte_carlo_uniform(std::size_t(0)); load_checkpoint(filename,s,Function(),range); }
+	catch (const std::runtime_error& e) { rejected = true; }
+	std::cout<<"Wrong type rejected     \t"<<(rejected?"[OK]":"[FAILED]")<<std::endl;
+
+	//Same data, different stepper: both keep their regions in an AdaptiveHeap
+	{ auto s = stepper_adaptive(nested(simpson,trapezoidal)); save_checkpoint(filename,s,s.init(Function(),range)); }
+	std::string message;
+	try { auto s = stepper_adaptive_retire(nested(simpson,trapezoidal),1.e-6); load_checkpoint(filename,s,Function(),range); }
+	catch (const std::runtime_error& e) { message = e.what(); }
+	std::cout<<"Wrong stepper rejected  \t"<<((message.find("different stepper")!=std::string::npos)?"[OK]":"[FAILED]")<<std::endl;
+	std::remove(filename);
+}
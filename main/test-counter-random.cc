@@ -0,0 +1,69 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <chrono>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+template<typename Integrator>
+void bench(const char* name, const Integrator& integrator) {
+	auto start = std::chrono::steady_clock::now();
+	double r = integrator.integrate(Function(),range_primary<6,double>());
+	auto end = std::chrono::steady_clock::now();
+	std::cout<<name<<"\t"<<std::setprecision(8)<<r<<"\t"<<std::chrono::duration<double,std::milli>(end-start).count()<<" ms"<<std::endl;
+}
+
+//Known answer test of Random123 (kat_vectors): counter, key and output as 32 bit words
+void known_answer(const char* name, std::array<std::uint32_t,4> ctr, std::array<std::uint32_t,2> key, std::array<std::uint32_t,4> expected) {
+	auto r = Philox::block((std::uint64_t(key[1])<<32) | key[0],(std::uint64_t(ctr[3])<<32) | ctr[2],(std::uint64_t(ctr[1])<<32) | ctr[0]);
+	std::array<std::uint32_t,4> out{std::uint32_t(r[0]),std::uint32_t(r[0]>>32),std::uint32_t(r[1]),std::uint32_t(r[1]>>32)};
+	std::cout<<"Philox4x32-10 "<<name<<"\t"<<((out==expected)?"[OK]":"[FAILED]")<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	known_answer("zeros ",{0u,0u,0u,0u},{0u,0u},{0x6627e8d5u,0xe169c58du,0xbc57ac4cu,0x9b00dbd8u});
+	known_answer("ones  ",{0xffffffffu,0xffffffffu,0xffffffffu,0xffffffffu},{0xffffffffu,0xffffffffu},{0x408f276du,0x41c83b0eu,0xa20bc7c6u,0x6d5451fdu});
+	known_answer("pi    ",{0x243f6a88u,0x85a308d3u,0x13198a2eu,0x03707344u},{0xa4093822u,0x299f31d0u},{0xd16cfe09u,0x94fdccebu,0x5001e420u,0x24126ea1u});
+
+	unsigned long samples = 4000000;
+	bench("Monte Carlo mt19937_64",integrator_monte_carlo_uniform(samples,0));
+	bench("Monte Carlo Philox    ",integrator_monte_carlo_uniform(Philox(0),samples));
+	bench("Monte Carlo counter   ",integrator_monte_carlo_counter(samples,0));
+
+	CounterRandom random(7);
+	bool same = true;
+	Philox stream(7,3);
+	for (std::uint64_t i = 0; i<100; ++i) {
+		auto a = random.uniform<double,4>(3,i);
+		same = same && (a == stream.uniform<double,4>()) && (a == Philox::uniform<double,4>(7,3,i));
+		for (double x : a) same = same && (x>=0.0) && (x<1.0);
+	}
+	std::cout<<"Indexed vs sequential samples\t"<<(same?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	auto stepper = stepper_monte_carlo_counter(0);
+	auto forward = stepper.init(Function(),range_primary<3,double>());
+	for (int i = 0; i<1000; ++i) stepper.step(Function(),range_primary<3,double>(),forward);
+	auto copy = reseeded(stepper,0);
+	auto again = copy.init(Function(),range_primary<3,double>());
+	for (int i = 0; i<1000; ++i) copy.step(Function(),range_primary<3,double>(),again);
+	std::cout<<"Counter stepper is reproducible\t"<<((stepper.integral(Function(),range_primary<3,double>(),forward) ==
+		copy.integral(Function(),range_primary<3,double>(),again))?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	std::vector<std::vector<double>> b1(8,std::vector<double>(8,0.0)), b2(8,std::vector<double>(8,0.0));
+	integrate_bins(integrator_bins_monte_carlo_counter(64*64,5),b1,Function(),range_primary<3,double>());
+	integrate_bins(integrator_bins_per_bin_parallel(integrator_monte_carlo_counter(64,5),5,4),b2,Function(),range_primary<3,double>());
+	double t1 = 0, t2 = 0;
+	for (std::size_t i = 0; i<8; ++i) for (std::size_t j = 0; j<8; ++j) { t1 += b1[i][j]/64.0; t2 += b2[i][j]/64.0; }
+	std::cout<<"Bins counter \t"<<t1<<"\nPer bin counter\t"<<t2<<std::endl;
+}
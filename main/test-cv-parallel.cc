@@ -0,0 +1,40 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+5)*x[i]*x[i]);
+		return r;
+	}
+};
+
+template<typename Integrator>
+std::vector<std::vector<double>> image(const Integrator& integrator) {
+	std::vector<std::vector<double>> bins(32,std::vector<double>(48,0.0));
+	integrate_bins(integrator,bins,Function(),range_primary<3,double>());
+	return bins;
+}
+
+double total(const std::vector<std::vector<double>>& bins) {
+	double t = 0; std::size_t n = 0;
+	for (const auto& row : bins) for (double b : row) { t += b; ++n; }
+	return t/double(n);
+}
+
+int main(int argc, char **argv) {
+	auto serial = image(integrator_optimized_adaptive_stratified_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),2000,16,std::size_t(0)));
+	auto p1 = image(integrator_optimized_adaptive_stratified_control_variates_parallel(nested(simpson,trapezoidal),error_single_dimension_standard(),2000,16,0,1));
+	std::cout<<"Serial integral   \t"<<std::setprecision(8)<<total(serial)<<std::endl;
+	std::cout<<"Parallel integral \t"<<std::setprecision(8)<<total(p1)<<std::endl;
+	for (std::size_t threads : {2, 8}) {
+		auto p = image(integrator_optimized_adaptive_stratified_control_variates_parallel(nested(simpson,trapezoidal),error_single_dimension_standard(),2000,16,0,threads));
+		std::cout<<"Parallel, 1 vs "<<threads<<" threads\t"<<((p1==p)?"[SAME]":"[DIFFERENT]")<<std::endl;
+	}
+}
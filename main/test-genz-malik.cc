@@ -0,0 +1,79 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+//Smooth function in any dimension, with known integral over [0,1]^DIM
+class Function {
+	mutable unsigned long calls = 0;
+public:
+	template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		++calls;
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+1)*x[i]);
+		return r;
+	}
+	template<std::size_t DIM>
+	static double exact() {
+		double r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::sin(double(i+1))/double(i+1);
+		return r;
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+template<typename Nested, std::size_t DIM>
+void compare(const char* name, const Nested& nested, unsigned long iterations) {
+	Function f;
+	double sol = integrator_adaptive_iterations(nested,iterations).integrate(f,range_primary<DIM,double>());
+	std::cout<<"  "<<name<<"\t"<<std::setw(9)<<f.evaluations()<<" evaluations\terror "<<std::abs(sol - Function::exact<DIM>())<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::cout<<std::scientific<<std::setprecision(3);
+
+	//Degree 7 polynomial, integrated exactly by the degree 7 rule (but not by the degree 5 one)
+	auto poly = [] (const std::array<double,4>& x) { return x[0]*x[0]*x[0]*x[1]*x[1]*x[2]*x[3] + std::pow(x[1],7) + 3.0*x[2]*x[2]*x[3]*x[3]; };
+	auto exact_poly = (1.0/4.0)*(1.0/3.0)*(1.0/2.0)*(1.0/2.0) + 1.0/8.0 + 3.0/9.0;
+	auto r = region(poly,genz_malik(),range_primary<4,double>());
+	std::cout<<"Degree 7 exactness\t\t"<<((std::abs(r.integral() - exact_poly)<1.e-12)?"[OK]":"[FAILED]")
+		<<"\t(degree 5 error "<<std::abs(r.integral() - r.error() - exact_poly)<<")"<<std::endl;
+	std::cout<<"Split along x1 (x1^7 term)\t"<<(((r.error(1)==r.error()) && (r.error(0)==0) && (r.error(2)==0) && (r.error(3)==0))?"[OK]":"[FAILED]")<<std::endl;
+	std::cout<<"Model integrates to integral\t"<<((std::abs(r.integral_subrange(r.range()) - r.integral())<1.e-12)?"[OK]":"[FAILED]")<<std::endl;
+	auto halves = r.integral_subrange(std::array<double,1>{0.0},std::array<double,1>{0.3}) + r.integral_subrange(std::array<double,1>{0.3},std::array<double,1>{1.0});
+	std::cout<<"Subranges add up\t\t"<<((std::abs(halves - r.integral())<1.e-12)?"[OK]":"[FAILED]")<<std::endl;
+
+	std::cout<<"Evaluations per region\t\t4D: "<<GenzMalik::nodes<4>()<<" (boole-simpson "<<5*5*5*5<<")\t6D: "
+		<<GenzMalik::nodes<6>()<<" (boole-simpson "<<5*5*5*5*5*5<<")"<<std::endl;
+
+	std::cout<<"4D adaptive"<<std::endl;
+	compare<GenzMalik,4>("genz-malik          ",genz_malik(),180);
+	compare<decltype(nested(boole,simpson)),4>("boole-simpson       ",nested(boole,simpson),40);
+	compare<decltype(nested(simpson,trapezoidal)),4>("simpson-trapezoidal ",nested(simpson,trapezoidal),300);
+	std::cout<<"6D adaptive"<<std::endl;
+	compare<GenzMalik,6>("genz-malik          ",genz_malik(),220);
+	compare<decltype(nested(boole,simpson)),6>("boole-simpson       ",nested(boole,simpson),4);
+	compare<decltype(nested(simpson,trapezoidal)),6>("simpson-trapezoidal ",nested(simpson,trapezoidal),40);
+
+	//Same interfaces: bins, control variates and checkpoints
+	std::array<std::size_t,2> resolution{4,4};
+	vector_dimensions<double,2> bins(resolution);
+	integrator_bins_adaptive(genz_malik(),200).integrate(bins,resolution,Function(),range_primary<4,double>());
+	double total = 0; for (auto pos : multidimensional_range(resolution)) total += bins[pos];
+	std::cout<<"Bins add up to the integral\t"<<((std::abs(total/16.0 - Function::exact<4>())<1.e-6)?"[OK]":"[FAILED]")<<std::endl;
+
+	double cv = integrator_adaptive_control_variates(genz_malik(),100,10000,std::size_t(3)).integrate(Function(),range_primary<4,double>());
+	std::cout<<"Control variates\t\terror "<<std::abs(cv - Function::exact<4>())<<std::endl;
+
+	auto stepper = stepper_adaptive(genz_malik());
+	Function f;
+	auto data = stepper.init(f,range_primary<5,double>());
+	for (int i = 0; i<50; ++i) stepper.step(f,range_primary<5,double>(),data);
+	save_checkpoint("test-genz-malik.tmp",stepper,data);
+	auto loaded = load_checkpoint("test-genz-malik.tmp",stepper,f,range_primary<5,double>());
+	std::remove("test-genz-malik.tmp");
+	std::cout<<"Checkpoint\t\t\t"<<((stepper.integral(f,range_primary<5,double>(),data)==stepper.integral(f,range_primary<5,double>(),loaded))?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
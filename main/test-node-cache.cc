@@ -0,0 +1,65 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <cmath>
+
+using namespace viltrum;
+
+//Counts its evaluations (from several threads too)
+class Function {
+	std::shared_ptr<std::atomic<unsigned long>> calls = std::make_shared<std::atomic<unsigned long>>(0);
+public:
+	template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float,DIM>& x) const {
+		++(*calls);
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=Float(1)/(Float(0.05) + x[i]*x[i]);
+		return r;
+	}
+	unsigned long evaluations() const { return *calls; }
+};
+
+//Same function, also with the batched interface
+class FunctionBatch : public Function {
+public:
+	template<typename Float, std::size_t DIM>
+	void evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<Float>& values) const {
+		for (std::size_t i = 0; i<points.size(); ++i) values[i] = (*this)(points[i]);
+	}
+};
+
+template<typename Integrator, typename F, typename Float, std::size_t DIM>
+void check(const char* name, const Integrator& integrator, const F& f, const Range<Float,DIM>& range, std::size_t max_nodes = std::size_t(1)<<20) {
+	F plain, cached;
+	double a = integrator.integrate(plain,range);
+	auto cache = node_cache(cached,range,max_nodes);
+	double b = integrator.integrate(cache,range);
+	std::cout<<name<<"\t"<<((std::abs(a-b)<=1.e-12*std::abs(a))?"[SAME]":"[DIFFERENT]")
+		<<"\t"<<std::setw(8)<<plain.evaluations()<<" -> "<<std::setw(8)<<cached.evaluations()<<" evaluations ("
+		<<std::setprecision(1)<<std::fixed<<100.0*(1.0 - double(cached.evaluations())/double(plain.evaluations()))<<"% fewer, "
+		<<cache.evictions()<<" evictions)"<<std::defaultfloat<<std::setprecision(6)<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	auto unit2 = range_primary<2,double>();
+	auto unit3 = range_primary<3,double>();
+	auto shifted = range(std::array<double,3>{-0.3,0.1,-1.0},std::array<double,3>{0.7,0.6,1.5});
+
+	check("Simpson 2D       ",integrator_adaptive_iterations(nested(simpson,trapezoidal),5000),Function(),unit2);
+	check("Simpson 3D       ",integrator_adaptive_iterations(nested(simpson,trapezoidal),5000),Function(),unit3);
+	check("Boole 3D         ",integrator_adaptive_iterations(nested(boole,simpson),2000),Function(),unit3);
+	check("Simpson 3D range ",integrator_adaptive_iterations(nested(simpson,trapezoidal),5000),Function(),shifted);
+	check("Small cache      ",integrator_adaptive_iterations(nested(simpson,trapezoidal),5000),Function(),unit3,4096);
+	check("Batch            ",integrator_adaptive_iterations(nested(simpson,trapezoidal),5000),FunctionBatch(),unit3);
+	check("Parallel         ",integrator_adaptive_parallel_iterations(nested(simpson,trapezoidal),5000,16,4),Function(),unit3);
+	{
+		auto cache = node_cache(Function(),unit3);
+		std::size_t empty = cache.capacity();
+		integrator_adaptive_iterations(nested(simpson,trapezoidal),5000).integrate(cache,unit3);
+		std::cout<<"Grows on demand  \t"<<(((empty==0) && (cache.capacity()>=2*cache.evaluations()) && (cache.capacity()<(std::size_t(1)<<21)))?"[OK]":"[FAILED]")
+			<<"\t"<<cache.capacity()<<" slots for "<<cache.evaluations()<<" nodes"<<std::endl;
+	}
+	//Nodes on thirds are not on the grid (except 0, 1/2 and 1): evaluated directly
+	check("Thirds           ",integrator_quadrature(steps<3>(simpson)),Function(),unit2);
+}
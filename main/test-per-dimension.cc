@@ -0,0 +1,89 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+//Pixel axes (x,y) with a discontinuity, and a smooth distance axis t, as in participating media
+class Render {
+	mutable unsigned long calls = 0;
+public:
+	double operator()(const std::array<double,3>& p) const {
+		++calls;
+		double occluded = (p[0] > 0.43)?0.2:1.0;
+		return occluded*(1.0 + 0.3*p[1])*std::exp(-3.0*p[2])*std::cos(8.0*p[2]);
+	}
+	//Integral over the pixel [x0,x1]x[y0,y1] (and the whole t axis)
+	static double pixel(double x0, double x1, double y0, double y1) {
+		double occluded = 1.0*std::max(0.0,std::min(x1,0.43) - x0) + 0.2*std::max(0.0,x1 - std::max(x0,0.43));
+		double y = (y1 - y0) + 0.15*(y1*y1 - y0*y0);
+		double t = (std::exp(-3.0)*(-3.0*std::cos(8.0) + 8.0*std::sin(8.0)) + 3.0)/73.0;
+		return occluded*y*t;
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+template<typename Nested>
+void compare(const char* name, const Nested& nested, unsigned long iterations, const vector_dimensions<double,2>& reference) {
+	Render f;
+	std::array<std::size_t,2> resolution{8,8};
+	vector_dimensions<double,2> bins(resolution);
+	integrator_bins_adaptive(nested,iterations).integrate(bins,resolution,f,range_primary<3,double>());
+	double error = 0;
+	for (auto pos : multidimensional_range(resolution)) error += std::abs(bins[pos] - reference[pos]);
+	std::cout<<"  "<<name<<"\t"<<std::setw(8)<<f.evaluations()<<" evaluations\terror "<<error/64.0<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::cout<<std::scientific<<std::setprecision(3);
+	auto smooth = [] (const std::array<double,3>& x) { return std::cos(x[0]*x[1] + 3.0*x[2]) + x[0]*x[0]*x[2]; };
+	auto range = range_primary<3,double>();
+
+	//Same rule on every dimension: same results as Region
+	auto q = nested(boole,simpson);
+	auto isotropic = region(smooth,q,range);
+	auto same = region(smooth,per_dimension(q,q,q),range);
+	auto close = [] (double a, double b) { return std::abs(a - b) <= 1.e-12*std::max(1.0,std::abs(a)); };
+	bool equal = close(isotropic.integral(),same.integral()) && close(isotropic.error(),same.error());
+	for (std::size_t d = 0; d<3; ++d) equal = equal && close(isotropic.error(d),same.error(d));
+	equal = equal && close(isotropic.approximation_at(std::array<double,3>{0.2,0.7,0.4}),same.approximation_at(std::array<double,3>{0.2,0.7,0.4}))
+				  && close(isotropic.approximation_at(std::array<double,2>{0.2,0.7}),same.approximation_at(std::array<double,2>{0.2,0.7}))
+				  && close(isotropic.integral_subrange(std::array<double,2>{0.1,0.3},std::array<double,2>{0.6,0.9}),
+				           same.integral_subrange(std::array<double,2>{0.1,0.3},std::array<double,2>{0.6,0.9}));
+	auto isplit = isotropic.split(smooth,1,3);
+	auto ssplit = same.split(smooth,1,3);
+	for (std::size_t i = 0; i<3; ++i) equal = equal && close(isplit[i].integral(),ssplit[i].integral()) && close(isplit[i].error(2),ssplit[i].error(2));
+	std::cout<<"Same rule on every dimension\t\t"<<(equal?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	//Simpson on x and y, Boole on t: exact for x^2 y^2 t^4, with 3x3x5 samples
+	auto aniso = per_dimension(nested(simpson,trapezoidal),nested(simpson,trapezoidal),nested(boole,simpson));
+	unsigned long calls = 0;
+	auto poly = [&calls] (const std::array<double,3>& x) { ++calls; return x[0]*x[0]*x[1]*x[1]*std::pow(x[2],4); };
+	auto r = region(poly,aniso,range);
+	std::cout<<"Anisotropic exactness ("<<calls<<" samples)\t"<<(close(r.integral(),1.0/45.0)?"[OK]":"[FAILED]")
+		<<"\t(error on t "<<std::abs(r.error(2))<<", on x "<<std::abs(r.error(0))<<")"<<std::endl;
+	auto p = r.polynomial();
+	std::array<double,3> x{0.3,0.6,0.8};
+	std::cout<<"Polynomial matches approximation\t"<<((close(p(x),r.approximation_at(x)) && close(p(x),poly(x)) && close(p.integral(),r.integral()))?"[OK]":"[FAILED]")<<std::endl;
+	auto halves = r.split(poly,2);
+	std::cout<<"Split keeps exactness\t\t\t"<<(close(halves[0].integral() + halves[1].integral(),1.0/45.0)?"[OK]":"[FAILED]")<<std::endl;
+
+	//Render-like integrand: evaluations spent on the smooth axis only
+	std::array<std::size_t,2> resolution{8,8};
+	vector_dimensions<double,2> reference(resolution);
+	for (auto pos : multidimensional_range(resolution))
+		reference[pos] = 64.0*Render::pixel(pos[0]/8.0,(pos[0]+1)/8.0,pos[1]/8.0,(pos[1]+1)/8.0);
+	std::cout<<"Render-like integrand, 8x8 bins"<<std::endl;
+	compare("simpson x simpson x boole ",aniso,1500,reference);
+	compare("boole^3                   ",nested(boole,simpson),500,reference);
+	compare("simpson^3                 ",nested(simpson,trapezoidal),2000,reference);
+
+	auto stepper = stepper_adaptive(aniso);
+	auto data = stepper.init(smooth,range);
+	for (int i = 0; i<30; ++i) stepper.step(smooth,range,data);
+	save_checkpoint("test-per-dimension.tmp",stepper,data);
+	auto loaded = load_checkpoint("test-per-dimension.tmp",stepper,smooth,range);
+	std::remove("test-per-dimension.tmp");
+	std::cout<<"Checkpoint\t\t\t\t"<<((stepper.integral(smooth,range,data)==stepper.integral(smooth,range,loaded))?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,92 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <set>
+
+using namespace viltrum;
+
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+1)*x[i]*x[i]);
+		return r;
+	}
+};
+
+//Checks that each dimension of the first 2^k points has exactly one point in each interval of size 2^-k
+template<std::size_t DIM, typename Points>
+bool stratified(const Points& points, std::size_t k) {
+	for (std::size_t d = 0; d<DIM; ++d) {
+		std::set<std::size_t> strata;
+		for (std::size_t i = 0; i<(std::size_t(1)<<k); ++i) strata.insert(std::size_t(points(i)[d]*double(std::size_t(1)<<k)));
+		if (strata.size() != (std::size_t(1)<<k)) return false;
+	}
+	return true;
+}
+
+//Checks the (0,m,2)-net property of the first two dimensions: one point in each elementary interval of area 2^-k
+template<typename Points>
+bool net(const Points& points, std::size_t k) {
+	for (std::size_t a = 0; a<=k; ++a) {
+		std::set<std::pair<std::size_t,std::size_t>> cells;
+		for (std::size_t i = 0; i<(std::size_t(1)<<k); ++i)
+			cells.insert({std::size_t(points(i)[0]*double(std::size_t(1)<<a)),std::size_t(points(i)[1]*double(std::size_t(1)<<(k-a)))});
+		if (cells.size() != (std::size_t(1)<<k)) return false;
+	}
+	return true;
+}
+
+template<typename Integrator>
+double rmse(const Integrator& integrator, double reference, std::size_t seeds) {
+	double e = 0;
+	for (std::size_t s = 0; s<seeds; ++s) {
+		auto i = integrator(s);
+		double v = i.integrate(Function(),range_primary<3,double>()) - reference;
+		e += v*v;
+	}
+	return std::sqrt(e/double(seeds));
+}
+
+int main(int argc, char **argv) {
+	auto plain = [] (std::size_t i) {
+		std::array<double,Sobol::table_dimensions> p;
+		for (std::size_t d = 0; d<p.size(); ++d) p[d] = double(Sobol::sample(std::uint32_t(i),d))*0x1.0p-32;
+		return p;
+	};
+	auto scrambled = [] (std::size_t i) { return Sobol::uniform<double,40>(std::uint32_t(i),17); };
+	std::cout<<"Sobol stratified     \t"<<((stratified<Sobol::table_dimensions>(plain,10) && net(plain,10))?"[OK]":"[FAILED]")<<std::endl;
+	std::cout<<"Scrambled stratified \t"<<((stratified<40>(scrambled,10) && net(scrambled,10))?"[OK]":"[FAILED]")<<std::endl;
+
+	double reference = integrator_adaptive_iterations(nested(boole,simpson),20000).integrate(Function(),range_primary<3,double>());
+	std::cout<<"Samples\tMC RMSE\t\tQMC RMSE"<<std::endl;
+	for (unsigned long samples : {64, 256, 1024, 4096}) {
+		std::cout<<samples<<"\t"<<std::setprecision(4)
+			<<rmse([samples] (std::size_t s) { return integrator_monte_carlo_counter(samples,s); },reference,64)<<"\t"
+			<<rmse([samples] (std::size_t s) { return integrator_quasi_monte_carlo(samples,s); },reference,64)<<std::endl;
+	}
+
+	//As the residual stepper of the control variates, each region gets its own scrambled sequence
+	auto cv_residual = [] (const auto& residual) {
+		return [residual] (std::size_t s) {
+			return integrator_stepper(stepper_adaptive_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),
+				residual(s),vector_sampler_uniform(std::size_t(s+1000)),32),32+4096);
+		};
+	};
+	std::cout<<"CV residual, MC RMSE\t"<<std::setprecision(4)<<rmse(cv_residual([] (std::size_t s) { return stepper_monte_carlo_counter(s); }),reference,64)
+		<<"\tQMC RMSE\t"<<rmse(cv_residual([] (std::size_t s) { return stepper_quasi_monte_carlo(s); }),reference,64)<<std::endl;
+
+	auto cv = [] (const auto& sampler) {
+		std::vector<std::vector<double>> bins(16,std::vector<double>(16,0.0));
+		integrate_bins(integrator_stratified_all_control_variates(region_generator(nested(simpson,trapezoidal),error_single_dimension_standard(),200),
+			AlphaOptimized(),sampler,std::mt19937_64(0),64),bins,Function(),range_primary<3,double>());
+		double t = 0;
+		for (const auto& row : bins) for (double b : row) t += b/256.0;
+		return t;
+	};
+	std::cout<<"Stratified CV, uniform sampler\t"<<std::setprecision(8)<<cv(FunctionSampler())<<std::endl;
+	std::cout<<"Stratified CV, QMC sampler    \t"<<std::setprecision(8)<<cv(FunctionSamplerQuasiMonteCarlo())<<std::endl;
+	std::cout<<"Reference                     \t"<<std::setprecision(8)<<reference<<std::endl;
+}
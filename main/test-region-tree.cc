@@ -0,0 +1,101 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <cmath>
+
+using namespace viltrum;
+
+template<typename F>
+double seconds(const F& f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template<typename Regions, typename Float, std::size_t DIM>
+std::size_t linear_locate(const Regions& regions, const std::array<Float,DIM>& x) {
+	for (std::size_t i = 0; i<regions.size(); ++i) if (regions[i].range().is_inside(x)) return i;
+	return 0;
+}
+
+template<typename Regions, typename Float, std::size_t DIMSUB>
+auto linear_integral(const Regions& regions, const Range<Float,DIMSUB>& range) {
+	auto sol = regions.front().integral_subrange(range.intersection(regions.front().range()));
+	for (auto it = regions.begin()+1; it != regions.end(); ++it) sol += (*it).integral_subrange(range.intersection((*it).range()));
+	return sol;
+}
+
+//Checks point location and subrange integrals against a linear scan over all the regions
+template<std::size_t DIMSUB, typename Regions>
+void check(const char* name, const Regions& regions, std::size_t npoints) {
+	constexpr std::size_t DIM = Regions::value_type::dimensions;
+	auto tree = region_tree(regions);
+	std::mt19937_64 rng(1);
+	std::uniform_real_distribution<double> u;
+	std::vector<std::array<double,DIM>> points(npoints);
+	for (auto& x : points) for (auto& xi : x) xi = u(rng);
+
+	std::size_t wrong = 0, a = 0, b = 0;
+	double tlinear = seconds([&] { for (const auto& x : points) a += linear_locate(regions,x); });
+	double ttree = seconds([&] { for (const auto& x : points) b += tree.locate(x); });
+	for (const auto& x : points) if (!regions[tree.locate(x)].range().is_inside(x)) ++wrong;
+	if (a != b) ++wrong; //Also keeps the timed loops from being optimized away
+
+	double error = 0;
+	std::vector<Range<double,DIMSUB>> ranges;
+	for (int i = 0; i<100; ++i) {
+		std::array<double,DIMSUB> p, q;
+		for (std::size_t d = 0; d<DIMSUB; ++d) { double s = u(rng), t = u(rng); p[d] = std::min(s,t); q[d] = std::max(s,t); }
+		ranges.push_back(range(p,q));
+	}
+	std::vector<double> vlinear, vtree;
+	double tilinear = seconds([&] { for (const auto& r : ranges) vlinear.push_back(linear_integral(regions,r)); });
+	double titree = seconds([&] { for (const auto& r : ranges) vtree.push_back(tree.integral_subrange(regions,r)); });
+	for (std::size_t i = 0; i<ranges.size(); ++i) error = std::max(error,std::abs(vlinear[i] - vtree[i]));
+
+	std::cout<<name<<"\t"<<std::setw(6)<<regions.size()<<" regions, depth "<<std::setw(3)<<tree.depth()
+		<<"\tlocate "<<((wrong==0)?"[OK]":"[FAILED]")<<" x"<<std::setprecision(3)<<tlinear/ttree
+		<<"\tsubrange "<<((error<1.e-12)?"[OK]":"[FAILED]")<<" x"<<tilinear/titree<<std::endl;
+}
+
+template<std::size_t DIM, typename F>
+auto adaptive_regions(const F& f, unsigned long iterations) {
+	auto stepper = stepper_adaptive(nested(simpson,trapezoidal));
+	auto regions = stepper.init(f,range_primary<DIM,double>());
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(f,range_primary<DIM,double>(),regions);
+	return std::vector<typename decltype(regions)::value_type>(regions.begin(),regions.end());
+}
+
+int main(int argc, char **argv) {
+	auto disc2 = [] (const std::array<double,2>& x) { return (x[0]*x[0] + x[1]*x[1] < 0.5)?std::sin(4.0*x[0]):1.0; };
+	auto peak3 = [] (const std::array<double,3>& x) { return 1.0/(0.001 + x[0]*x[0] + (x[1]-0.3)*(x[1]-0.3) + x[2]); };
+	check<2>("Discontinuity 2D",adaptive_regions<2>(disc2,500),10000);
+	check<2>("Discontinuity 2D",adaptive_regions<2>(disc2,20000),10000);
+	check<2>("Peak 3D (2D bins)",adaptive_regions<3>(peak3,20000),10000);
+
+	//Not from halving: splits in three parts
+	auto smooth = [] (const std::array<double,2>& x) { return std::exp(x[0] - x[1]); };
+	std::vector<decltype(region(smooth,simpson,range_primary<2,double>()))> thirds, parts{region(smooth,simpson,range_primary<2,double>())};
+	for (int level = 0; level<3; ++level) {
+		thirds.clear();
+		for (const auto& r : parts) for (auto& s : r.split(smooth,level%2,3)) thirds.push_back(s);
+		parts.swap(thirds);
+	}
+	check<2>("Thirds 2D       ",parts,1000);
+
+	//As a control variate, the same values as the regions it is made of
+	auto cv = control_variate_quadrature_adaptive(nested(simpson,trapezoidal),2000)(disc2,range_primary<2,double>());
+	std::mt19937_64 rng(2);
+	std::uniform_real_distribution<double> u;
+	bool same = true;
+	for (int i = 0; i<1000; ++i) {
+		std::array<double,2> x{u(rng),u(rng)};
+		const auto& regions = cv.get_regions();
+		same = same && (std::abs(cv(x) - regions[linear_locate(regions,x)].approximation_at(x))<1.e-12);
+	}
+	auto sub = range(std::array<double,2>{0.1,0.2},std::array<double,2>{0.7,0.9});
+	same = same && (std::abs(cv.integral(disc2,sub) - linear_integral(cv.get_regions(),sub))<1.e-12);
+	std::cout<<"Control variate\t\t"<<(same?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,67 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+//Peak in a corner of the 4D unit cube, with known integral
+class Function {
+public:
+	double operator()(const std::array<double,4>& x) const {
+		double r = 1;
+		for (auto xi : x) r*=1.0/(0.05 + xi);
+		return r;
+	}
+	static double exact() { return std::pow(std::log(1.05/0.05),4); }
+};
+
+template<typename Stepper>
+void run(const char* name, const Stepper& stepper, unsigned long iterations) {
+	Function f;
+	auto range = range_primary<4,double>();
+	auto heap = stepper.init(f,range);
+	std::size_t largest = 0;
+	for (unsigned long i = 0; i<iterations; ++i) {
+		stepper.step(f,range,heap);
+		largest = std::max(largest,heap.size());
+	}
+	std::cout<<"  "<<name<<"\t"<<std::setw(6)<<largest<<" regions at most ("<<std::setw(6)<<heap.retired()<<" retired)\terror "
+		<<std::abs(stepper.integral(f,range,heap) - Function::exact())/Function::exact()<<"\testimate "<<stepper.error_estimate(f,range,heap)<<std::endl;
+}
+
+int main(int argc, char **argv) {
+	std::cout<<std::scientific<<std::setprecision(3);
+	Function f;
+	auto range = range_primary<4,double>();
+	unsigned long iterations = 20000;
+
+	//Without threshold nor limit, the same as StepperAdaptive
+	auto plain = stepper_adaptive(nested(boole,simpson));
+	auto same = stepper_adaptive_retire(nested(boole,simpson),0.0);
+	auto a = plain.init(f,range); auto b = same.init(f,range);
+	for (unsigned long i = 0; i<2000; ++i) { plain.step(f,range,a); same.step(f,range,b); }
+	std::cout<<"No retirement\t\t\t"<<((plain.integral(f,range,a)==same.integral(f,range,b))?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	std::cout<<"Boole 4D, "<<iterations<<" iterations ("<<625*sizeof(double)<<" bytes of samples per region)"<<std::endl;
+	run("all regions         ",stepper_adaptive(nested(boole,simpson)),iterations);
+	run("threshold 1e-6      ",stepper_adaptive_retire(nested(boole,simpson),1.e-6),iterations);
+	run("at most 4000 regions",stepper_adaptive_retire(nested(boole,simpson),0.0,4000),iterations);
+	run("both                ",stepper_adaptive_retire(nested(boole,simpson),1.e-6,4000),iterations);
+
+	//Everything retired: steps do nothing
+	auto all = stepper_adaptive_retire(nested(boole,simpson),1.e10);
+	auto c = all.init(f,range);
+	for (int i = 0; i<10; ++i) all.step(f,range,c);
+	std::cout<<"All retired\t\t\t"<<(((c.size()==0) && (c.retired()==2))?"[OK]":"[FAILED]")<<std::endl;
+
+	//The retired regions are kept in the checkpoint totals
+	auto bounded = stepper_adaptive_retire(nested(boole,simpson),1.e-6,1000);
+	auto d = bounded.init(f,range);
+	for (int i = 0; i<3000; ++i) bounded.step(f,range,d);
+	save_checkpoint("test-retire.tmp",bounded,d);
+	auto loaded = load_checkpoint("test-retire.tmp",bounded,f,range);
+	std::remove("test-retire.tmp");
+	std::cout<<"Checkpoint\t\t\t"<<(((bounded.integral(f,range,d)==bounded.integral(f,range,loaded)) &&
+		(bounded.error_estimate(f,range,d)==bounded.error_estimate(f,range,loaded)))?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,94 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <random>
+
+using namespace viltrum;
+
+//Smooth function in any dimension, with known integral over [0,1]^DIM
+class Function {
+	mutable unsigned long calls = 0;
+public:
+	template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		++calls;
+		Float s = 0;
+		for (std::size_t i = 0; i<DIM; ++i) s += Float(i+1)*x[i]/Float(DIM);
+		return std::exp(s);
+	}
+	template<std::size_t DIM>
+	static double exact() {
+		double r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) { double a = double(i+1)/double(DIM); r*=(std::exp(a) - 1.0)/a; }
+		return r;
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+template<typename Nested, std::size_t DIM>
+void compare(const char* name, const Nested& nested, unsigned long iterations) {
+	Function f;
+	double sol = integrator_adaptive_iterations(nested,iterations).integrate(f,range_primary<DIM,double>());
+	std::cout<<"  "<<name<<"\t"<<std::setw(9)<<f.evaluations()<<" evaluations\terror "<<std::abs(sol - Function::exact<DIM>())<<std::endl;
+}
+
+template<std::size_t DIM>
+double interpolation_error() {
+	Function f;
+	auto r = region(f,sparse_grid<3>(),range_primary<DIM,double>());
+	std::mt19937_64 rng(1);
+	std::uniform_real_distribution<double> u;
+	double e = 0;
+	for (int s = 0; s<100; ++s) {
+		std::array<double,DIM> x; for (auto& xi : x) xi = u(rng);
+		e = std::max(e,std::abs(r.approximation_at(x) - f(x)));
+	}
+	return e;
+}
+
+int main(int argc, char **argv) {
+	std::cout<<std::scientific<<std::setprecision(3);
+
+	std::cout<<"Nodes per region (level 3)\t6D: "<<SparseGrid<3>::nodes<6>()<<" (boole "<<15625<<")\t8D: "
+		<<SparseGrid<3>::nodes<8>()<<" (boole "<<390625<<")"<<std::endl;
+
+	//Total degree 7 polynomial in 6D, integrated exactly at level 3
+	auto poly = [] (const std::array<double,6>& x) { return std::pow(x[0],3)*x[1]*x[1]*x[5]*x[4] + std::pow(x[2],7) + x[3]*x[1]; };
+	double exact_poly = (1.0/4.0)*(1.0/3.0)*(1.0/2.0)*(1.0/2.0) + 1.0/8.0 + 1.0/4.0;
+	auto r = region(poly,sparse_grid<3>(),range_primary<6,double>());
+	std::cout<<"Degree 7 exactness\t\t"<<((std::abs(r.integral() - exact_poly)<1.e-12)?"[OK]":"[FAILED]")<<std::endl;
+	std::cout<<"Split along x2 (x2^7 term)\t"<<((std::abs(r.error(2))>=std::abs(r.error(0)))?"[OK]":"[FAILED]")<<std::endl;
+	std::cout<<"Model integrates to integral\t"<<((std::abs(r.integral_subrange(r.range()) - r.integral())<1.e-12)?"[OK]":"[FAILED]")<<std::endl;
+	auto halves = r.integral_subrange(std::array<double,2>{0.0,0.0},std::array<double,2>{0.3,1.0}) + r.integral_subrange(std::array<double,2>{0.3,0.0},std::array<double,2>{1.0,1.0});
+	std::cout<<"Subranges add up\t\t"<<((std::abs(halves - r.integral())<1.e-12)?"[OK]":"[FAILED]")<<std::endl;
+	std::cout<<"Interpolation error (level 3)\t6D: "<<interpolation_error<6>()<<"\t8D: "<<interpolation_error<8>()<<std::endl;
+
+	std::cout<<"6D adaptive"<<std::endl;
+	compare<SparseGrid<3>,6>("sparse grid level 3 ",sparse_grid<3>(),100);
+	compare<GenzMalik,6>("genz-malik          ",genz_malik(),370);
+	std::cout<<"8D adaptive"<<std::endl;
+	compare<SparseGrid<3>,8>("sparse grid level 3 ",sparse_grid<3>(),50);
+	compare<GenzMalik,8>("genz-malik          ",genz_malik(),150);
+
+	//As control variates, with the residual integrated with Monte Carlo
+	Function f;
+	double cv = integrator_adaptive_control_variates(sparse_grid<2>(),50,10000,std::size_t(3)).integrate(f,range_primary<8,double>());
+	double mc = integrator_monte_carlo_uniform(10000,std::size_t(3)).integrate(f,range_primary<8,double>());
+	std::cout<<"Control variates 8D\t\terror "<<std::abs(cv - Function::exact<8>())<<"\t(Monte Carlo "<<std::abs(mc - Function::exact<8>())<<")"<<std::endl;
+
+	std::array<std::size_t,2> resolution{4,4};
+	vector_dimensions<double,2> bins(resolution);
+	integrator_optimized_adaptive_stratified_control_variates(sparse_grid<2>(),error_single_dimension_standard(),20,16,std::size_t(5))
+		.integrate(bins,resolution,Function(),range_primary<6,double>());
+	double total = 0; for (auto pos : multidimensional_range(resolution)) total += bins[pos];
+	std::cout<<"Stratified control variates 6D\terror "<<std::abs(total/16.0 - Function::exact<6>())<<std::endl;
+
+	auto stepper = stepper_adaptive(sparse_grid<2>());
+	auto data = stepper.init(f,range_primary<6,double>());
+	for (int i = 0; i<20; ++i) stepper.step(f,range_primary<6,double>(),data);
+	save_checkpoint("test-sparse-grid.tmp",stepper,data);
+	auto loaded = load_checkpoint("test-sparse-grid.tmp",stepper,f,range_primary<6,double>());
+	std::remove("test-sparse-grid.tmp");
+	std::cout<<"Checkpoint\t\t\t"<<((stepper.integral(f,range_primary<6,double>(),data)==stepper.integral(f,range_primary<6,double>(),loaded))?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
@@ -0,0 +1,57 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+
+using namespace viltrum;
+
+//Smooth almost everywhere except for a sharp ridge, so the residual concentrates in a few regions
+class Function {
+public:
+    template<typename Float, std::size_t DIM>
+	Float operator()(const std::array<Float, DIM>& x) const {
+		Float r = 1;
+		for (std::size_t i = 0; i<DIM; ++i) r*=std::cos(Float(i+1)*x[i]);
+		return r + ((x[0]+x[1]>Float(1))?Float(1):Float(0));
+	}
+};
+
+struct Value {
+	double value;
+	double operator()() const { return value; }
+};
+
+template<typename VectorSampler>
+double rmse(const VectorSampler& vs, double reference, std::size_t seeds) {
+	double e = 0;
+	for (std::size_t s = 0; s<seeds; ++s) {
+		auto integrator = integrator_stepper(stepper_adaptive_control_variates(nested(simpson,trapezoidal),error_single_dimension_standard(),
+			stepper_monte_carlo_uniform(s),vs(s),100),1100);
+		double v = integrator.integrate(Function(),range_primary<2,double>()) - reference;
+		e += v*v;
+	}
+	return std::sqrt(e/double(seeds));
+}
+
+int main(int argc, char **argv) {
+	std::vector<Value> values{{1.0},{2.0},{3.0},{4.0},{0.0}};
+	auto sampler = vector_sampler_weighted([] (const Value& v) { return v(); },0,0.0)(values);
+	std::vector<std::size_t> count(values.size(),0);
+	std::vector<double> probability(values.size(),0.0);
+	std::size_t n = 1000000;
+	for (std::size_t i = 0; i<n; ++i) {
+		auto [index, p] = sampler.sample();
+		++count[index]; probability[index] = p;
+	}
+	bool ok = (count[4] == 0);
+	for (std::size_t i = 0; i<4; ++i) {
+		ok = ok && (std::abs(probability[i] - values[i]()/10.0) < 1.e-12) && (std::abs(double(count[i])/double(n) - values[i]()/10.0) < 3.e-3);
+		std::cout<<"Weight "<<values[i]()<<"\tprobability "<<probability[i]<<"\tfrequency "<<double(count[i])/double(n)<<std::endl;
+	}
+	std::cout<<"Alias table\t"<<(ok?"[OK]":"[FAILED]")<<std::endl;
+
+	double reference = integrator_adaptive_iterations(nested(boole,simpson),20000).integrate(Function(),range_primary<2,double>());
+	std::cout<<"Uniform region selection RMSE\t"<<std::setprecision(4)<<rmse([] (std::size_t s) { return vector_sampler_uniform(s+1000); },reference,200)<<std::endl;
+	std::cout<<"Volume region selection RMSE \t"<<std::setprecision(4)<<rmse([] (std::size_t s) { return vector_sampler_volume(s+1000); },reference,200)<<std::endl;
+	std::cout<<"Error region selection RMSE  \t"<<std::setprecision(4)<<rmse([] (std::size_t s) { return vector_sampler_error(error_single_dimension_standard(),s+1000); },reference,200)<<std::endl;
+}
@@ -0,0 +1,105 @@
+#include "../viltrum.h"
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace viltrum;
+
+//Frame of an "animation": a peak that moves over a smooth background. Evaluations can take some latency (in
+//microseconds), as an expensive integrand (a renderer) would.
+class Frame {
+	double cx, cy;
+	unsigned int latency;
+	mutable std::atomic<unsigned long> calls{0};
+public:
+	Frame(double cx, double cy, unsigned int latency = 0) : cx(cx), cy(cy), latency(latency) { }
+	double operator()(const std::array<double,2>& x) const {
+		++calls;
+		if (latency>0) std::this_thread::sleep_for(std::chrono::microseconds(latency));
+		double dx = x[0]-cx, dy = x[1]-cy;
+		return 0.5*std::cos(3.0*x[0]*x[1]) + std::exp(-(dx*dx+dy*dy)/0.002);
+	}
+	unsigned long evaluations() const { return calls; }
+};
+
+double reference(const Frame& f) {
+	return integrator_adaptive_iterations(nested(boole,simpson),200000).integrate(f,range_primary<2,double>());
+}
+
+int main(int argc, char **argv) {
+	auto stepper = stepper_adaptive(nested(simpson,trapezoidal));
+	auto range = range_primary<2,double>();
+	const unsigned long iterations = 20000;
+
+	Frame f0(0.3,0.3);
+	auto previous = stepper.init(f0,range);
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(f0,range,previous);
+	auto partition = region_partition(previous);
+
+	Frame same(0.3,0.3);
+	auto again = stepper.init(same,range,partition);
+	std::cout<<"Same integrand, same regions\t\t"
+		<<(((again.size()==previous.size()) && (std::abs(stepper.integral(same,range,again) - stepper.integral(f0,range,previous))<=1.e-12))?"[OK]":"[FAILED]")<<std::endl
+		<<"  Evaluations (replayed / original)\t"<<same.evaluations()<<" / "<<f0.evaluations()<<std::endl;
+
+	//Next frame: replayed in parallel without searching for the splits
+	Frame f1(0.302,0.301), f1_cold(0.302,0.301), f1_parallel(0.302,0.301);
+	auto t0 = std::chrono::steady_clock::now();
+	auto warm = stepper.init(f1,range,partition);
+	auto t1 = std::chrono::steady_clock::now();
+	auto warm_parallel = stepper.init(f1_parallel,range,partition,0.0,4);
+	auto t2 = std::chrono::steady_clock::now();
+	auto cold = stepper.init(f1_cold,range);
+	for (unsigned long i = 0; i<iterations; ++i) stepper.step(f1_cold,range,cold);
+	auto t3 = std::chrono::steady_clock::now();
+	auto ms = [] (auto a, auto b) { return std::chrono::duration<double,std::milli>(b-a).count(); };
+	double ref1 = reference(Frame(0.302,0.301));
+	std::cout<<std::scientific<<std::setprecision(3)
+		<<"Next frame (warm)\t\t"<<std::setw(8)<<f1.evaluations()<<" evaluations\terror "<<std::abs(stepper.integral(f1,range,warm) - ref1)<<std::endl
+		<<"Next frame (cold)\t\t"<<std::setw(8)<<f1_cold.evaluations()<<" evaluations\terror "<<std::abs(stepper.integral(f1_cold,range,cold) - ref1)<<std::endl
+		<<std::fixed<<std::setprecision(1)
+		<<"  Time warm / warm 4 threads / cold\t"<<ms(t0,t1)<<" / "<<ms(t1,t2)<<" / "<<ms(t2,t3)<<" ms"<<std::endl
+		<<"  Same result with 4 threads\t\t"<<((stepper.integral(f1,range,warm)==stepper.integral(f1_parallel,range,warm_parallel))?"[SAME]":"[DIFFERENT]")<<std::endl;
+
+	//The peak moved away: the refinement around the old position is not replayed
+	Frame f2(0.7,0.7), f2_fine(0.7,0.7);
+	double ref2 = reference(Frame(0.7,0.7));
+	auto coarse = stepper.init(f2,range,partition,1.e-9);
+	auto fine = stepper.init(f2_fine,range,partition);
+	std::cout<<std::scientific<<std::setprecision(3)
+		<<"Peak moved, coarsened\t\t"<<std::setw(8)<<f2.evaluations()<<" evaluations\t"<<std::setw(6)<<coarse.size()<<" regions\terror "<<std::abs(stepper.integral(f2,range,coarse) - ref2)<<std::endl
+		<<"Peak moved, not coarsened\t"<<std::setw(8)<<f2_fine.evaluations()<<" evaluations\t"<<std::setw(6)<<fine.size()<<" regions\terror "<<std::abs(stepper.integral(f2_fine,range,fine) - ref2)<<std::endl
+		<<"  Fewer evaluations\t\t\t"<<((f2.evaluations()<f2_fine.evaluations())?"[OK]":"[FAILED]")<<std::endl;
+	for (unsigned long i = 0; i<iterations/4; ++i) stepper.step(f2,range,coarse);
+	std::cout<<"  Refined afterwards\t"<<std::setw(8)<<f2.evaluations()<<" evaluations\t"<<std::setw(6)<<coarse.size()<<" regions\terror "<<std::abs(stepper.integral(f2,range,coarse) - ref2)<<std::endl;
+
+	//With an expensive integrand, the replay takes the same evaluations as the cold start but, as it needs no search,
+	//they are spread over the threads, while the cold start evaluates them one step after another
+	{
+		const unsigned long slow_iterations = 1000;
+		Frame s0(0.3,0.3);
+		auto slow_previous = stepper.init(s0,range);
+		for (unsigned long i = 0; i<slow_iterations; ++i) stepper.step(s0,range,slow_previous);
+		Frame s1(0.302,0.301,50), s1_parallel(0.302,0.301,50), s1_cold(0.302,0.301,50);
+		auto t0 = std::chrono::steady_clock::now();
+		auto slow_warm = stepper.init(s1,range,region_partition(slow_previous));
+		auto t1 = std::chrono::steady_clock::now();
+		auto slow_parallel = stepper.init(s1_parallel,range,region_partition(slow_previous),0.0,8);
+		auto t2 = std::chrono::steady_clock::now();
+		auto slow_cold = stepper.init(s1_cold,range);
+		for (unsigned long i = 0; i<slow_iterations; ++i) stepper.step(s1_cold,range,slow_cold);
+		auto t3 = std::chrono::steady_clock::now();
+		std::cout<<"Expensive next frame\t\t"<<std::setw(8)<<s1_parallel.evaluations()<<" evaluations (cold "<<s1_cold.evaluations()<<")"<<std::endl
+			<<std::fixed<<std::setprecision(1)<<"  Time warm / warm 8 threads / cold\t"<<ms(t0,t1)<<" / "<<ms(t1,t2)<<" / "<<ms(t2,t3)<<" ms"<<std::endl
+			<<"  Faster than cold with 8 threads\t"<<(((ms(t1,t2)<0.5*ms(t2,t3)) && (stepper.integral(s1,range,slow_warm)==stepper.integral(s1_parallel,range,slow_parallel)))?"[OK]":"[FAILED]")<<std::endl;
+	}
+
+	vector_dimensions<double,2> bins_warm({4,4}), bins_fine({4,4});
+	auto bins_stepper = stepper_bins_adaptive(nested(simpson,trapezoidal));
+	bins_stepper.integral(bins_warm,bins_warm.resolution(),f1,range,bins_stepper.init(bins_warm.resolution(),f1,range,partition));
+	bins_stepper.integral(bins_fine,bins_fine.resolution(),f1,range,warm);
+	std::cout<<"Bins warm start\t\t\t\t"<<((bins_warm.raw_data()==bins_fine.raw_data())?"[SAME]":"[DIFFERENT]")<<std::endl;
+}
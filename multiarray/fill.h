@@ -2,6 +2,8 @@
 
 #include "slice.h"
 #include "array.h"
+#include "../quadrature/multidimensional-range.h"
+#include <vector>
 
 
 namespace viltrum {
@@ -29,6 +31,24 @@ typename std::enable_if<std::is_convertible<V,typename MA::value_type>::value,vo
 		}
 }
 
+/*
+ * fb(points,values) receives all the sample positions (normalized in [0,1]) and writes all the values at once.
+ */
+template<typename FB, typename MA>
+void fill_batch(const FB& fb, MA& ma) {
+	std::array<std::size_t,MA::dimensions> resolution; resolution.fill(MA::size);
+	std::vector<std::array<double,MA::dimensions>> points; points.reserve(multidimensional_range(resolution));
+	for (auto idx : multidimensional_range(resolution)) {
+		std::array<double,MA::dimensions> p;
+		for (std::size_t d = 0; d<MA::dimensions; ++d) p[d] = double(idx[d])/double(MA::size-1);
+		points.push_back(p);
+	}
+	std::vector<typename MA::value_type> values(points.size());
+	fb(points,values);
+	std::size_t i = 0;
+	for (auto idx : multidimensional_range(resolution)) ma[idx] = std::move(values[i++]);
+}
+
 /*
 template<typename F, typename MA, typename MAS>
 void fill_blank(const F& f, MA& ma, const MAS& mas, std::size_t dim, std::size_t part, std::size_t out_of) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "multiarray-constref.h"
+#include "multiarray.h"
 
 namespace viltrum {
 //F is a function that gets an array of size SIZE and returns a single element.
@@ -102,9 +103,54 @@ struct fold_all_helper<Base,F,0> {
 	}
 };
 
+template<typename MA>
+struct is_multiarray : std::false_type {};
+template<typename T, std::size_t SIZE, std::size_t DIM>
+struct is_multiarray<multiarray<T,SIZE,DIM>> : std::true_type {};
+
+//Eager fold over the contiguous storage of a multiarray. Returns a multiarray with one dimension less (or a single value if
+//there is only one dimension). Each value is computed with exactly the same operations as the lazy fold, in the same order.
+template<typename T, std::size_t SIZE, std::size_t DIM, typename F>
+auto fold_eager(const multiarray<T,SIZE,DIM>& ma, const F& f, std::size_t d) {
+	using R = std::decay_t<decltype(f(std::declval<std::array<T,SIZE>>()))>;
+	const T* in = ma.raw_data();
+	std::array<T,SIZE> values;
+	if constexpr (DIM == 1) {
+		for (std::size_t k = 0; k<SIZE; ++k) values[k] = in[k];
+		return R(f(values));
+	} else {
+		constexpr std::size_t n = multiarray_values(SIZE,DIM-1);
+		multiarray<R,SIZE,DIM-1> sol;
+		R* out = sol.raw_data();
+		if (d == 0) { //Most common case (and the one used by fold_all): the folded values are consecutive
+			for (std::size_t o = 0; o<n; ++o, in+=SIZE) {
+				for (std::size_t k = 0; k<SIZE; ++k) values[k] = in[k];
+				out[o] = f(values);
+			}
+		} else {
+			std::size_t stride = 1; 
+			for (std::size_t i = 0; i<d; ++i) stride*=SIZE;
+			for (std::size_t outer = 0; outer<n; outer+=stride, in+=stride*SIZE) 
+				for (std::size_t inner = 0; inner<stride; ++inner) {
+					for (std::size_t k = 0; k<SIZE; ++k) values[k] = in[k*stride+inner];
+					out[outer+inner] = f(values);
+				}
+		}
+		return sol;
+	}
+}
+
+template<typename T, std::size_t SIZE, std::size_t DIM, typename F>
+auto fold_all_eager(const multiarray<T,SIZE,DIM>& ma, const F& f) {
+	if constexpr (DIM == 1) return fold_eager(ma,f,0);
+	else return fold_all_eager(fold_eager(ma,f,0),f);
+}
+
 template<typename Base, typename F>
 auto fold_all(Base&& base, F&& f) {
-	return detail::fold_all_helper<Base,F>::apply(std::forward<Base>(base),std::forward<F>(f));
+	//Multiarrays with actual storage are folded eagerly, one dimension at a time, instead of stacking lazy views
+	if constexpr (is_multiarray<std::decay_t<Base>>::value) return fold_all_eager(base,f);
+	else return detail::fold_all_helper<Base,F>::apply(std::forward<Base>(base),std::forward<F>(f));
 }
 }
 }
@@ -19,6 +19,9 @@ auto fold(Base& base, F&& f, std::size_t d=0);
 template<typename Base, typename F>
 auto fold_all(Base&& base, F&& f);
 
+template<typename T, std::size_t SIZE, std::size_t DIM, typename F>
+auto fold_eager(const multiarray<T,SIZE,DIM>& ma, const F& f, std::size_t d);
+
 template<typename Base, typename F>
 auto transform(Base&& base, F&& f, std::size_t  d);
 
@@ -47,6 +50,13 @@ auto slice(MA& ma, std::size_t dimension, std::size_t index) noexcept;
 template<typename F, typename MA>
 std::vector<multiarray<typename MA::value_type,MA::size,MA::dimensions>>
 split(const F& f, const MA& ma, std::size_t dim, std::size_t parts);
+
+template<typename FB, typename MA>
+void fill_batch(const FB& fb, MA& ma);
+
+template<typename FB, typename MA>
+std::vector<multiarray<typename MA::value_type,MA::size,MA::dimensions>>
+split_batch(const FB& fb, const MA& ma, std::size_t dim, std::size_t parts);
 }
 
 
@@ -92,6 +102,11 @@ public:
 	auto split(const F& f, int dim, std::size_t parts) const {
 		return detail::split(f,static_cast<const MA&>(*this),dim,parts);
 	}
+	//Same as split but all the new samples are evaluated with a single call fb(points,values)
+	template<typename FB>
+	auto split_batch(const FB& fb, int dim, std::size_t parts) const {
+		return detail::split_batch(fb,static_cast<const MA&>(*this),dim,parts);
+	}
 
 //	template<typename MA2>
 //	auto operator==(const multiarray_const<MA2>& ma2) const ->
@@ -116,6 +131,11 @@ public:
 	void fill(const F& f) {
 		detail::fill(f,*static_cast<MA*>(this));
 	}
+	//Same as fill but all the samples are evaluated with a single call fb(points,values)
+	template<typename FB>
+	void fill_batch(const FB& fb) {
+		detail::fill_batch(fb,*static_cast<MA*>(this));
+	}
 	//We need to redefine this because otherwise it gets hidden
 	auto slice(std::size_t index, int dimension = 0) const noexcept {
 		return detail::slice(static_cast<const MA&>(*this),dimension,index);
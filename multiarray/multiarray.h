@@ -2,14 +2,40 @@
 
 #include <vector>
 #include <array>
+#include <type_traits>
 #include "multiarray-crtp.h"
 #include "../quadrature/multidimensional-range.h"
 
+//Multiarrays whose SIZE^DIM values take at most this many bytes are stored inline (std::array) instead of on dynamic 
+//memory. Define it as 0 before including viltrum to always use dynamic memory.
+#ifndef VILTRUM_MULTIARRAY_INLINE_BYTES
+#define VILTRUM_MULTIARRAY_INLINE_BYTES 512
+#endif
+
 namespace viltrum {
+
+namespace detail {
+constexpr std::size_t multiarray_values(std::size_t size, std::size_t dim) { return (dim==0)?1:size*multiarray_values(size,dim-1); }
+
+template<typename T, std::size_t N, bool INLINE = (N*sizeof(T) <= VILTRUM_MULTIARRAY_INLINE_BYTES)>
+struct multiarray_storage {
+	std::vector<T> values; //We use a vector (even though it is on dynamic memory) because of move semantics. It will be faster to return.
+	multiarray_storage() : values(N) { }
+	multiarray_storage(const T& t) : values(N,t) { }
+};
+
+//Small multiarrays (the common case for regions and polynomials) avoid the allocator entirely
+template<typename T, std::size_t N>
+struct multiarray_storage<T,N,true> {
+	std::array<T,N> values;
+	multiarray_storage() : values{} { }
+	multiarray_storage(const T& t) { values.fill(t); }
+};
+}
     
 template<typename T, std::size_t SIZE, std::size_t DIM>
 class multiarray  : public multiarray_mutable<multiarray<T,SIZE,DIM>> {
-	std::vector<T> data; //We use a vector (even though it is on dynamic memory) because of move semantics. It will be faster to return.	
+	detail::multiarray_storage<T,detail::multiarray_values(SIZE,DIM)> storage;
 
 public:
 	static constexpr std::size_t size = SIZE;
@@ -24,15 +50,29 @@ private:
 		return r;
 	}
 public:
-	multiarray() : data(power(DIM))              {}
-	multiarray(const T& t) : data(power(DIM),t)  {}
+	//True if the values are stored inside the object instead of on dynamic memory
+	static constexpr bool inline_storage = !std::is_same_v<decltype(storage.values),std::vector<T>>;
+
+	multiarray() : storage()              {}
+	multiarray(const T& t) : storage(t)   {}
 	multiarray(const multiarray& that) = default;
 	multiarray(multiarray&& that) noexcept = default;
 	//In C++ we trust for the automatic copy and move constructors, and automatic copy and move assignments. We might need to define them if we add new ones
 	
-	T& operator[](const index_type& indices) { return data[index_of(indices)]; }
-	const T& operator[](const index_type& indices) const { return data[index_of(indices)]; }
+	T& operator[](const index_type& indices) { return storage.values[index_of(indices)]; }
+	const T& operator[](const index_type& indices) const { return storage.values[index_of(indices)]; }
+
+	//Contiguous storage of the SIZE^DIM values (first dimension changes faster)
+	T* raw_data() { return storage.values.data(); }
+	const T* raw_data() const { return storage.values.data(); }
 	
+	//Same as fold, but all the values are computed right away from the contiguous storage. Faster when all the values 
+	//of the result are going to be used (requires including fold.h)
+	template<typename F>
+	auto fold_eager(const F& f, std::size_t d = 0) const {
+		return detail::fold_eager(*this,f,d);
+	}
+
 	template<typename M>
 	multiarray& operator=(const multiarray_const<M>& that) {
 		static_assert(std::is_convertible<value_type,typename M::value_type>::value,"Should have the same value type");
@@ -59,7 +99,7 @@ public:
 
 	T& at(const std::array<std::size_t,DIM>& indices) {
 		if (!range_check(indices)) throw std::out_of_range("Index out of range in multidimensional array");
-		return data.at(index_of(indices));
+		return storage.values.at(index_of(indices));
 	}
 };
 
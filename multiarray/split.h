@@ -4,6 +4,7 @@
 #include "fill.h"
 #include "multiarray.h"
 #include <list>
+#include <tuple>
 
 namespace viltrum {
 
@@ -48,6 +49,46 @@ split(const F& f, const MA& ma, std::size_t dim, std::size_t parts) {
 	return s;
 }
 
+/*
+ * Same result as split, but the new samples are gathered first and evaluated with a single call fb(points,values),
+ * points being normalized in [0,1] as in split. Shared samples are copied from the original multiarray.
+ */
+template<typename FB, typename MA>
+std::vector<multiarray<typename MA::value_type,MA::size,MA::dimensions>>
+split_batch(const FB& fb, const MA& ma, std::size_t dim, std::size_t parts) {
+	assert(dim < MA::dimensions);
+	std::vector<multiarray<typename MA::value_type,MA::size,MA::dimensions>> s(parts);
+	std::size_t full_size = parts*(MA::size-1) + 1;
+	std::array<std::size_t,MA::dimensions> resolution; resolution.fill(MA::size);
+	std::vector<std::array<double,MA::dimensions>> points;
+	std::vector<std::tuple<std::size_t,std::array<std::size_t,MA::dimensions>>> targets;
+	for (std::size_t part = 0; part<parts; ++part) for (auto idx : multidimensional_range(resolution)) {
+		std::size_t i = part*(MA::size-1) + idx[dim];
+		if ((i%parts) == 0) {//We copy the values
+			auto src = idx; src[dim] = i/parts;
+			s[part][idx] = ma[src];
+		} else if ((idx[dim] < (MA::size-1)) || (part == (parts-1))) { //Merging points are copied afterwards
+			std::array<double,MA::dimensions> p;
+			for (std::size_t d = 0; d<MA::dimensions; ++d) p[d] = double(idx[d])/double(MA::size-1);
+			p[dim] = double(i)/double(full_size - 1);
+			points.push_back(p);
+			targets.emplace_back(part,idx);
+		}
+	}
+	std::vector<typename MA::value_type> values(points.size());
+	fb(points,values);
+	for (std::size_t i = 0; i<targets.size(); ++i)
+		s[std::get<0>(targets[i])][std::get<1>(targets[i])] = std::move(values[i]);
+	//We copy at the merging points (limits between two splitted multiarrays)
+	for (std::size_t part = 1; part<parts; ++part) {
+		if constexpr (MA::dimensions > 1)
+			s[part-1].slice(MA::size-1,dim) = s[part].slice(0,dim);
+		else
+			s[part-1][{MA::size-1}]=s[part][{0}];
+	}
+	return s;
+}
+
 /*
 template<typename F, typename MA, typename MAS>
 void fill_blank(const F& f, MA& ma, const MAS& mas, std::size_t dim, std::size_t part, std::size_t out_of) {
@@ -41,7 +41,7 @@ svg_cpp_plot::_2d::polyline convergence_samples(const Stepper& stepper, const F&
     while (samples_plot <= max_samples) {
         for (auto& d : data) stepper.step(f,range,d);
         if (f.samples() > samples_plot*averaging) {
-            err = 0; for (auto d : data) err += (error(stepper.integral(f,range,d))/double(averaging)); 
+            err = 0; for (const auto& d : data) err += (error(stepper.integral(f,range,d))/double(averaging)); 
             samples_vs_error.add_point(std::log(f.samples()/averaging),std::log(err));
             samples_plot += max_samples/resolution;
         }
@@ -69,7 +69,7 @@ svg_cpp_plot::_2d::polyline convergence_time(const Stepper& stepper, const F& fu
             end = std::chrono::steady_clock::now();
             elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(end - start);
         }
-        err = 0; for (auto d : data) err += (error(stepper.integral(f,range,d))/double(averaging)); 
+        err = 0; for (const auto& d : data) err += (error(stepper.integral(f,range,d))/double(averaging)); 
         end = std::chrono::steady_clock::now();
         elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(end - start);
         time_vs_error.add_point(std::log(elapsed.count()/averaging),std::log(err));
@@ -99,7 +99,7 @@ svg_cpp_plot::_2d::polyline convergence_bins_samples(const Stepper& stepper, con
     while (samples_plot <= max_samples) {
         for (auto& d : data) stepper.step(vector_resolution(sol),f,range,d);
         if (f.samples() > samples_plot*averaging) {
-            err = 0; for (auto d : data) {
+            err = 0; for (const auto& d : data) {
                 std::fill(sol.begin(),sol.end(),0.0);
                 auto bins = vector_bins(sol);
                 stepper.integral(bins, vector_resolution(sol), f, range, d);
@@ -152,7 +152,7 @@ svg_cpp_plot::_2d::polyline convergence_bins_time(const Stepper& stepper, const
             end = std::chrono::steady_clock::now();
             elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(end - start);
         }
-        err = 0; for (auto d : data) {
+        err = 0; for (const auto& d : data) {
             std::fill(sol.begin(),sol.end(),0.0);
             auto bins = vector_bins(sol);
             stepper.integral(bins, vector_resolution(sol), f, range, d);
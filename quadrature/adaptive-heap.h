@@ -0,0 +1,106 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <tuple>
+#include <algorithm>
+#include <type_traits>
+#include "../utils/compensated-sum.h"
+
+namespace viltrum {
+
+/**
+ * Regions of an adaptive stepper, stored as a max-heap on their error (the first element of extra()), together with
+ * running totals of their integral and their error. The totals are updated on every push and pop, so the integral
+ * and the total error can be queried in O(1) instead of walking all the regions. The regions can be read and iterated
+ * as a const std::vector, but only modified through push, pop and retire, which keep the totals right.
+ **/
+template<typename R>
+class AdaptiveHeap {
+public:
+    using value_type = R;
+    using const_iterator = typename std::vector<R>::const_iterator;
+    using iterator = const_iterator;
+    using integral_type = std::decay_t<decltype(std::declval<const R&>().integral())>;
+    using error_type = std::decay_t<decltype(std::get<0>(std::declval<const R&>().extra()))>;
+
+private:
+    std::vector<R> regions_;
+    CompensatedSum<integral_type> integral_total;
+    CompensatedSum<error_type> error_total;
+    std::size_t retired_regions = 0;
+
+    static bool compare(const R& a, const R& b) {
+        return std::get<0>(a.extra()) < std::get<0>(b.extra());
+    }
+
+public:
+    const_iterator begin() const { return regions_.begin(); }
+    const_iterator end() const { return regions_.end(); }
+    std::size_t size() const { return regions_.size(); }
+    bool empty() const { return regions_.empty(); }
+    const R& operator[](std::size_t i) const { return regions_[i]; }
+    const R& front() const { return regions_.front(); }
+    const R& back() const { return regions_.back(); }
+    const std::vector<R>& regions() const & { return regions_; }
+    //Hands the regions over once no more steps will be done on the heap
+    std::vector<R> regions() && { return std::move(regions_); }
+
+    void push(R&& r) {
+        integral_total += r.integral(); error_total += std::get<0>(r.extra());
+        regions_.push_back(std::forward<R>(r));
+        std::push_heap(regions_.begin(),regions_.end(),compare);
+    }
+
+    //Removes and returns the region with the highest error
+    R pop() {
+        std::pop_heap(regions_.begin(),regions_.end(),compare);
+        R r = std::move(regions_.back()); regions_.pop_back();
+        integral_total -= r.integral(); error_total -= std::get<0>(r.extra());
+        return r;
+    }
+
+    /**
+     * Retired regions are not kept (so their samples are freed) and will never be split, but their integral and error
+     * stay in the totals. Only for plain integrals, as the regions left no longer cover the whole range.
+     **/
+    void retire(R&& r) {
+        integral_total += r.integral(); error_total += std::get<0>(r.extra());
+        ++retired_regions;
+    }
+
+    //Retires all but the keep regions with the highest error
+    void retire_lowest(std::size_t keep) {
+        if (keep >= regions_.size()) return;
+        std::nth_element(regions_.begin(),regions_.begin()+keep,regions_.end(),[] (const R& a, const R& b) { return compare(b,a); });
+        retired_regions += regions_.size() - keep;
+        regions_.erase(regions_.begin()+keep,regions_.end());
+        std::make_heap(regions_.begin(),regions_.end(),compare);
+    }
+
+    //Number of retired regions (since construction or the last load)
+    std::size_t retired() const { return retired_regions; }
+
+    integral_type integral() const { return integral_total.value(); }
+    error_type error() const { return error_total.value(); }
+
+    //Checkpointing (see checkpoint.h). The regions are stored in heap order, so pushing them back in the same order
+    //rebuilds exactly the same heap, and the totals are restored as they were. args are passed to R::load.
+    template<typename Out>
+    void save(Out& out) const {
+        out.write(std::uint64_t(regions_.size()));
+        for (const R& r : regions_) r.save(out);
+        out.write(integral_total); out.write(error_total);
+    }
+
+    template<typename In, typename... Args>
+    void load(In& in, const Args&... args) {
+        regions_.clear(); retired_regions = 0;
+        std::uint64_t n; in.read(n);
+        regions_.reserve(std::size_t(n));
+        for (std::uint64_t i = 0; i<n; ++i) push(R::load(in,args...));
+        in.read(integral_total); in.read(error_total);
+    }
+};
+
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <type_traits>
+
+namespace viltrum {
+
+/**
+ * Optional batched integrand interface. Besides the usual f(const std::array<Float,DIM>&), an integrand can provide
+ *
+ *     void evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<value_type>& values) const;
+ *
+ * where values has already the same size as points. If present, regions use it to evaluate all their samples
+ * (and all the new samples on each split) in a single call, so the integrand can vectorize and amortize its cost.
+ **/
+template<typename F, typename Float, std::size_t DIM, typename VT, typename = void>
+struct has_evaluate_batch : std::false_type {};
+
+template<typename F, typename Float, std::size_t DIM, typename VT>
+struct has_evaluate_batch<F,Float,DIM,VT,std::void_t<decltype(std::declval<const F&>().evaluate_batch(
+        std::declval<const std::vector<std::array<Float,DIM>>&>(),std::declval<std::vector<VT>&>()))>> : std::true_type {};
+
+template<typename F, typename Float, std::size_t DIM, typename VT>
+constexpr bool has_evaluate_batch_v = has_evaluate_batch<F,Float,DIM,VT>::value;
+
+//Evaluates all the points, through evaluate_batch if available and one by one otherwise
+template<typename F, typename Float, std::size_t DIM, typename VT>
+void evaluate_batch(const F& f, const std::vector<std::array<Float,DIM>>& points, std::vector<VT>& values) {
+    values.resize(points.size());
+    if constexpr (has_evaluate_batch_v<F,Float,DIM,VT>) f.evaluate_batch(points,values);
+    else for (std::size_t i = 0; i<points.size(); ++i) values[i] = f(points[i]);
+}
+
+}
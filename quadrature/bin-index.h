@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include "multidimensional-range.h"
+#include "../utils/parallel.h"
+
+namespace viltrum {
+
+/**
+ * Compact (CSR-like) index from bins to the items (typically regions) that overlap them. All the item indices are
+ * stored in a single contiguous array, grouped by bin, plus one offset per bin, so there is no allocation per bin.
+ * Items appear in each bin in increasing order, also when the index is built in parallel.
+ **/
+template<std::size_t DIMBINS>
+class BinIndex {
+    std::array<std::size_t,DIMBINS> res;
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> items;
+
+    std::size_t position(const std::array<std::size_t,DIMBINS>& p) const {
+        std::size_t pos = 0, prod = 1;
+        for (std::size_t d = 0;d<DIMBINS; ++d) {
+            pos += p[d]*prod; prod*=res[d];
+        }
+        return pos;
+    }
+
+public:
+    //Item indices of a single bin
+    class bin {
+        const std::size_t* b;
+        const std::size_t* e;
+    public:
+        bin(const std::size_t* b, const std::size_t* e) : b(b), e(e) { }
+        const std::size_t* begin() const { return b; }
+        const std::size_t* end() const { return e; }
+        std::size_t size() const { return e - b; }
+        bool empty() const { return b == e; }
+        std::size_t operator[](std::size_t i) const { return b[i]; }
+    };
+
+    /**
+     * bins_of(i) returns the MultidimensionalRange of bins overlapped by item i, for i in [0,nitems). It is called
+     * twice per item: first to count the items of each bin and then to fill the index.
+     **/
+    template<typename BinsOf>
+    BinIndex(const std::array<std::size_t,DIMBINS>& resolution, std::size_t nitems, const BinsOf& bins_of, std::size_t nthreads = 1) :
+            res(resolution) {
+        std::size_t nbins = 1;
+        for (auto r : res) nbins*=r;
+        offsets.assign(nbins+1,0);
+        if (nthreads <= 1) {
+            for (std::size_t i = 0; i<nitems; ++i) for (auto pos : bins_of(i)) ++offsets[position(pos)+1];
+            for (std::size_t b = 0; b<nbins; ++b) offsets[b+1] += offsets[b];
+            items.resize(offsets[nbins]);
+            std::vector<std::size_t> cursor(offsets.begin(),offsets.end()-1);
+            for (std::size_t i = 0; i<nitems; ++i) for (auto pos : bins_of(i)) items[cursor[position(pos)]++] = i;
+        } else {
+            std::unique_ptr<std::atomic<std::size_t>[]> counter(new std::atomic<std::size_t>[nbins]);
+            for (std::size_t b = 0; b<nbins; ++b) counter[b] = 0;
+            parallel_for(nitems, [&] (std::size_t i, std::size_t) {
+                for (auto pos : bins_of(i)) counter[position(pos)].fetch_add(1,std::memory_order_relaxed);
+            }, nthreads);
+            for (std::size_t b = 0; b<nbins; ++b) { offsets[b+1] = offsets[b] + counter[b]; counter[b] = offsets[b]; }
+            items.resize(offsets[nbins]);
+            parallel_for(nitems, [&] (std::size_t i, std::size_t) {
+                for (auto pos : bins_of(i)) items[counter[position(pos)].fetch_add(1,std::memory_order_relaxed)] = i;
+            }, nthreads);
+            //Items arrive in any order, we sort them so the result does not depend on the threads
+            parallel_for(nbins, [&] (std::size_t b, std::size_t) {
+                std::sort(items.begin()+offsets[b],items.begin()+offsets[b+1]);
+            }, nthreads);
+        }
+    }
+
+    const std::array<std::size_t,DIMBINS>& resolution() const { return res; }
+    //Number of bins
+    std::size_t size() const { return offsets.size()-1; }
+    bin operator[](std::size_t b) const { return bin(items.data()+offsets[b],items.data()+offsets[b+1]); }
+    bin operator[](const std::array<std::size_t,DIMBINS>& p) const { return (*this)[position(p)]; }
+};
+
+//The items of a bin as a container (size() and operator[]) of the elements of items
+template<typename Container, typename Bin>
+class BinItems {
+    const Container& items;
+    Bin b;
+public:
+    BinItems(const Container& items, const Bin& b) : items(items), b(b) { }
+    std::size_t size() const { return b.size(); }
+    decltype(auto) operator[](std::size_t i) const { return items[b[i]]; }
+};
+
+template<typename Container, typename Bin>
+BinItems<Container,Bin> bin_items(const Container& items, const Bin& b) {
+    return BinItems<Container,Bin>(items,b);
+}
+
+template<std::size_t DIMBINS, typename BinsOf>
+BinIndex<DIMBINS> bin_index(const std::array<std::size_t,DIMBINS>& resolution, std::size_t nitems, const BinsOf& bins_of, std::size_t nthreads = 1) {
+    return BinIndex<DIMBINS>(resolution,nitems,bins_of,nthreads);
+}
+
+}
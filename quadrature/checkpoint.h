@@ -0,0 +1,343 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <tuple>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <typeinfo>
+#include <type_traits>
+#include <cstdio>
+#include "range.h"
+
+#if defined(_WIN32)
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace viltrum {
+
+/**
+ * Checkpoints: the data of a stepper is saved to a binary file and restored later, so long integrations can be
+ * interrupted and resumed without evaluating the integrand again. Steppers that support it provide
+ *
+ *     void checkpoint(Out& out, const Data& data) const;
+ *     Data resume(In& in, const F& f, const Range<Float,DIM>& range) const;               //Regular steppers
+ *     Data resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f,  //Bins steppers
+ *                 const Range<Float,DIM>& range) const;
+ *
+ * where resume only uses f and range to know the type of the data (and the range, if it is not saved). Steppers
+ * with an internal state of their own (typically a random number generator) also provide
+ *
+ *     void save(Out& out) const;
+ *     void load(In& in);
+ *
+ * which is saved together with the data, so a resumed integration continues exactly as an uninterrupted one would
+ * instead of repeating the same random numbers. Any other type with those two members is also written and read
+ * through them.
+ **/
+namespace detail {
+
+template<typename T, typename Out, typename = void>
+struct has_save : std::false_type {};
+template<typename T, typename Out>
+struct has_save<T,Out,std::void_t<decltype(std::declval<const T&>().save(std::declval<Out&>()))>> : std::true_type {};
+
+template<typename T, typename In, typename = void>
+struct has_load : std::false_type {};
+template<typename T, typename In>
+struct has_load<T,In,std::void_t<decltype(std::declval<T&>().load(std::declval<In&>()))>> : std::true_type {};
+
+//Standard random number engines (and other types) that can be written and read as text
+template<typename T, typename = void>
+struct is_streamable : std::false_type {};
+template<typename T>
+struct is_streamable<T,std::void_t<decltype(std::declval<std::ostream&>()<<std::declval<const T&>()),
+                                   decltype(std::declval<std::istream&>()>>std::declval<T&>())>> : std::true_type {};
+
+template<typename T> struct is_std_array : std::false_type {};
+template<typename T, std::size_t N> struct is_std_array<std::array<T,N>> : std::true_type {};
+template<typename T> struct is_std_vector : std::false_type {};
+template<typename T, typename A> struct is_std_vector<std::vector<T,A>> : std::true_type {};
+template<typename T> struct is_tuple : std::false_type {};
+template<typename... T> struct is_tuple<std::tuple<T...>> : std::true_type {};
+template<typename T1, typename T2> struct is_tuple<std::pair<T1,T2>> : std::true_type {};
+template<typename T> struct is_range : std::false_type {};
+template<typename T, std::size_t DIM> struct is_range<Range<T,DIM>> : std::true_type {};
+
+template<typename T> struct always_false : std::false_type {};
+
+constexpr char checkpoint_magic[8] = {'V','I','L','T','R','U','M','C'};
+
+}
+
+class CheckpointWriter {
+    std::string filename;
+    std::string temporary;
+    std::ofstream file;
+
+public:
+    static constexpr std::uint32_t version = 1;
+
+    //The file is written under a temporary name and only replaces filename on close(), so an interrupted checkpoint
+    //never overwrites the previous one
+    CheckpointWriter(const std::string& filename) :
+            filename(filename), temporary(filename+".tmp"), file(temporary, std::ios::binary | std::ios::trunc) {
+        if (!file) throw std::runtime_error("Cannot open checkpoint file "+temporary+" for writing");
+        write_bytes(detail::checkpoint_magic,sizeof(detail::checkpoint_magic));
+        write(version);
+    }
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    void write_bytes(const void* data, std::size_t bytes) {
+        file.write(static_cast<const char*>(data),std::streamsize(bytes));
+    }
+
+    template<typename T>
+    void write_values(const T* values, std::size_t n) {
+        if constexpr (std::is_trivially_copyable_v<T> && !detail::has_save<T,CheckpointWriter>::value) write_bytes(values,n*sizeof(T));
+        else for (std::size_t i = 0; i<n; ++i) write(values[i]);
+    }
+
+    template<typename T>
+    void write(const T& t) {
+        if constexpr (detail::has_save<T,CheckpointWriter>::value) t.save(*this);
+        else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) write_bytes(&t,sizeof(T));
+        else if constexpr (detail::is_std_array<T>::value) write_values(t.data(),t.size());
+        else if constexpr (detail::is_tuple<T>::value) std::apply([this] (const auto&... e) { (write(e),...); },t);
+        else if constexpr (detail::is_std_vector<T>::value) { write(std::uint64_t(t.size())); write_values(t.data(),t.size()); }
+        else if constexpr (std::is_same_v<T,std::string>) { write(std::uint64_t(t.size())); write_bytes(t.data(),t.size()); }
+        else if constexpr (detail::is_range<T>::value) { write(t.min()); write(t.max()); }
+        else if constexpr (detail::is_streamable<T>::value) {
+            std::ostringstream s; s<<t; write(s.str());
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>) write_bytes(&t,sizeof(T));
+        else static_assert(detail::always_false<T>::value,"Type cannot be written to a checkpoint (it needs a save member)");
+    }
+
+    //Does nothing for types without state of their own
+    template<typename T>
+    void write_state(const T& t) {
+        if constexpr (detail::has_save<T,CheckpointWriter>::value) t.save(*this);
+    }
+
+    void close() {
+        if (!file.is_open()) return;
+        file.close();
+        if (!file) throw std::runtime_error("Error writing checkpoint file "+temporary);
+        if (std::rename(temporary.c_str(),filename.c_str())!=0)
+            throw std::runtime_error("Cannot rename checkpoint file "+temporary+" to "+filename);
+    }
+
+    //Without close() the temporary file is left behind and the previous checkpoint (if any) is kept
+    ~CheckpointWriter() { if (file.is_open()) file.close(); }
+};
+
+/**
+ * Reads a checkpoint through a read-only memory mapping of the whole file (on platforms without mmap the file is
+ * read into memory at once).
+ **/
+class CheckpointReader {
+    const char* data = nullptr;
+    std::size_t bytes = 0;
+    std::size_t offset = 0;
+#if defined(_WIN32)
+    std::vector<char> buffer;
+#else
+    //Owns the mapping, so it is also released when the header checks of the constructor throw
+    struct Mapping {
+        void* address = nullptr;
+        std::size_t bytes = 0;
+        Mapping() = default;
+        Mapping(const Mapping&) = delete;
+        Mapping& operator=(const Mapping&) = delete;
+        ~Mapping() { if (address) ::munmap(address,bytes); }
+    } mapping;
+#endif
+
+public:
+    CheckpointReader(const std::string& filename) {
+#if defined(_WIN32)
+        std::ifstream file(filename, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open checkpoint file "+filename);
+        buffer.assign(std::istreambuf_iterator<char>(file),std::istreambuf_iterator<char>());
+        data = buffer.data(); bytes = buffer.size();
+#else
+        int fd = ::open(filename.c_str(),O_RDONLY);
+        if (fd<0) throw std::runtime_error("Cannot open checkpoint file "+filename);
+        struct stat st;
+        if (::fstat(fd,&st)!=0) { ::close(fd); throw std::runtime_error("Cannot stat checkpoint file "+filename); }
+        bytes = std::size_t(st.st_size);
+        if (bytes>0) {
+            void* m = ::mmap(nullptr,bytes,PROT_READ,MAP_PRIVATE,fd,0);
+            if (m==MAP_FAILED) { ::close(fd); throw std::runtime_error("Cannot map checkpoint file "+filename); }
+            mapping.address = m; mapping.bytes = bytes;
+            data = static_cast<const char*>(m);
+        }
+        ::close(fd);
+#endif
+        char magic[sizeof(detail::checkpoint_magic)];
+        read_bytes(magic,sizeof(magic));
+        if (std::memcmp(magic,detail::checkpoint_magic,sizeof(magic))!=0)
+            throw std::runtime_error(filename+" is not a checkpoint file");
+        std::uint32_t v = read<std::uint32_t>();
+        if (v!=CheckpointWriter::version)
+            throw std::runtime_error(filename+" has checkpoint version "+std::to_string(v)+", expected "+std::to_string(CheckpointWriter::version));
+    }
+
+    CheckpointReader(const CheckpointReader&) = delete;
+    CheckpointReader& operator=(const CheckpointReader&) = delete;
+
+    //Bytes not read yet
+    std::size_t remaining() const { return bytes - offset; }
+
+    void read_bytes(void* dest, std::size_t n) {
+        if (n>remaining()) throw std::runtime_error("Truncated checkpoint file");
+        std::memcpy(dest,data+offset,n);
+        offset+=n;
+    }
+
+    template<typename T>
+    void read_values(T* values, std::size_t n) {
+        if constexpr (std::is_trivially_copyable_v<T> && !detail::has_load<T,CheckpointReader>::value) read_bytes(values,n*sizeof(T));
+        else for (std::size_t i = 0; i<n; ++i) read(values[i]);
+    }
+
+    template<typename T>
+    void read(T& t) {
+        if constexpr (detail::has_load<T,CheckpointReader>::value) t.load(*this);
+        else if constexpr (std::is_arithmetic_v<T> || std::is_enum_v<T>) read_bytes(&t,sizeof(T));
+        else if constexpr (detail::is_std_array<T>::value) read_values(t.data(),t.size());
+        else if constexpr (detail::is_tuple<T>::value) std::apply([this] (auto&... e) { (read(e),...); },t);
+        else if constexpr (detail::is_std_vector<T>::value) { t.resize(std::size_t(read<std::uint64_t>())); read_values(t.data(),t.size()); }
+        else if constexpr (std::is_same_v<T,std::string>) { t.resize(std::size_t(read<std::uint64_t>())); read_bytes(t.data(),t.size()); }
+        else if constexpr (detail::is_range<T>::value) { auto a = read<std::decay_t<decltype(t.min())>>(); auto b = read<std::decay_t<decltype(t.max())>>(); t = T(a,b); }
+        else if constexpr (detail::is_streamable<T>::value) {
+            std::istringstream s(read<std::string>()); s>>t;
+            if (!s) throw std::runtime_error("Corrupted checkpoint file");
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>) read_bytes(&t,sizeof(T));
+        else static_assert(detail::always_false<T>::value,"Type cannot be read from a checkpoint (it needs a load member)");
+    }
+
+    //Ranges are not default constructible, so they are read directly
+    template<typename T>
+    T read() {
+        if constexpr (detail::is_range<T>::value) {
+            auto a = read<std::decay_t<decltype(std::declval<const T&>().min())>>();
+            auto b = read<std::decay_t<decltype(std::declval<const T&>().max())>>();
+            return T(a,b);
+        } else { T t; read(t); return t; }
+    }
+
+    //Does nothing for types without state of their own
+    template<typename T>
+    void read_state(T& t) {
+        if constexpr (detail::has_load<T,CheckpointReader>::value) t.load(*this);
+    }
+};
+
+namespace detail {
+//Types of the stepper and of the data in the file, so a checkpoint is never resumed with a different stepper (even
+//one with the same data, such as Monte Carlo with another random number generator) or integrand type. The names
+//come from typeid, which is implementation defined: checkpoints can only be resumed by a program built with the same
+//compiler (and standard library) as the one that wrote them, which is also what the raw binary layout of the data
+//requires.
+template<typename Stepper, typename Data>
+std::string checkpoint_signature() { return std::string(typeid(Stepper).name())+" "+typeid(Data).name(); }
+
+inline void check_signature(CheckpointReader& in, const std::string& expected, const std::string& filename) {
+    if (in.read<std::string>()!=expected)
+        throw std::runtime_error(filename+" is a checkpoint of a different stepper or integrand type (or was written by a program built with another compiler)");
+}
+}
+
+/**
+ * Saves the data of a stepper (and the state of the stepper, if any) to filename. iterations is stored as is, so
+ * the caller knows how many steps are left when resuming.
+ **/
+template<typename Stepper, typename Data>
+void save_checkpoint(const std::string& filename, const Stepper& stepper, const Data& data, unsigned long iterations = 0) {
+    CheckpointWriter out(filename);
+    out.write(detail::checkpoint_signature<Stepper,Data>());
+    out.write(std::uint64_t(iterations));
+    out.write_state(stepper);
+    stepper.checkpoint(out,data);
+    out.close();
+}
+
+//Restores the data of a stepper (and the state of the stepper, if any) from filename, without evaluating f
+template<typename Stepper, typename F, typename Float, std::size_t DIM>
+auto load_checkpoint(const std::string& filename, Stepper& stepper, const F& f, const Range<Float,DIM>& range, unsigned long& iterations) {
+    using Data = decltype(stepper.init(f,range));
+    CheckpointReader in(filename);
+    detail::check_signature(in,detail::checkpoint_signature<Stepper,Data>(),filename);
+    iterations = (unsigned long)(in.read<std::uint64_t>());
+    in.read_state(stepper);
+    Data data = stepper.resume(in,f,range);
+    if (in.remaining()>0) throw std::runtime_error(filename+" has trailing data");
+    return data;
+}
+
+template<typename Stepper, typename F, typename Float, std::size_t DIM>
+auto load_checkpoint(const std::string& filename, Stepper& stepper, const F& f, const Range<Float,DIM>& range) {
+    unsigned long iterations;
+    return load_checkpoint(filename,stepper,f,range,iterations);
+}
+
+template<typename Stepper, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+auto load_bins_checkpoint(const std::string& filename, Stepper& stepper, const std::array<std::size_t,DIMBINS>& resolution,
+        const F& f, const Range<Float,DIM>& range, unsigned long& iterations) {
+    using Data = decltype(stepper.init(resolution,f,range));
+    CheckpointReader in(filename);
+    detail::check_signature(in,detail::checkpoint_signature<Stepper,Data>(),filename);
+    iterations = (unsigned long)(in.read<std::uint64_t>());
+    in.read_state(stepper);
+    Data data = stepper.resume(in,resolution,f,range);
+    if (in.remaining()>0) throw std::runtime_error(filename+" has trailing data");
+    return data;
+}
+
+template<typename Stepper, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+auto load_bins_checkpoint(const std::string& filename, Stepper& stepper, const std::array<std::size_t,DIMBINS>& resolution,
+        const F& f, const Range<Float,DIM>& range) {
+    unsigned long iterations;
+    return load_bins_checkpoint(filename,stepper,resolution,f,range,iterations);
+}
+
+inline bool checkpoint_exists(const std::string& filename) {
+    return bool(std::ifstream(filename, std::ios::binary));
+}
+
+/**
+ * Same as integrator_bins_stepper(stepper,iterations).integrate(...), but the data is saved to filename every
+ * checkpoint_every iterations (and at the end). If filename already exists, the integration resumes from it
+ * instead of starting from scratch.
+ **/
+template<typename Stepper, typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+void integrate_bins_stepper_checkpoint(const std::string& filename, unsigned long checkpoint_every, Stepper stepper, unsigned long iterations,
+        Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) {
+    unsigned long done = 0;
+    auto data = checkpoint_exists(filename)?
+        load_bins_checkpoint(filename,stepper,resolution,f,range,done):
+        stepper.init(resolution,f,range);
+    for (; done<iterations; ) {
+        stepper.step(resolution,f,range,data);
+        ++done;
+        if ((checkpoint_every>0) && ((done%checkpoint_every)==0) && (done<iterations)) save_checkpoint(filename,stepper,data,done);
+    }
+    save_checkpoint(filename,stepper,data,done);
+    stepper.integral(bins,resolution,f,range,data);
+}
+
+}
@@ -3,6 +3,8 @@
 #include "region.h"
 #include "monte-carlo.h"
 #include "integrate-bins-stepper.h"
+#include "tensor-horner.h"
+#include "region-tree.h"
 
 namespace viltrum {
 
@@ -51,6 +53,8 @@ public:
         return data.control_variate.integral(f,range) + residual_stepper.integral(f,range,data.residual);
     }
 
+    void reseed(std::uint64_t seed) { reseed_random(residual_stepper,seed); }
+
     StepperControlVariate(RS&& r, CVG&& c) :
         residual_stepper(std::forward<RS>(r)), cv_generator(std::forward<CVG>(c)) { }
 };
@@ -121,13 +125,14 @@ class ControlVariateQuadrature {
     template<typename Float, std::size_t DIM, typename VT>
     class Function {
         Region<Float,Rule,DIM,VT> reg;
+        decltype(tensor_horner(std::declval<const Region<Float,Rule,DIM,VT>&>().polynomial())) approximation;
     public:
         VT operator()(const std::array<Float,DIM>& x) const {
-            return reg.approximation_at(x);
+            return approximation(x);
         }
         template<typename F, std::size_t DIMSUB>
         VT integral(const F& f, const Range<Float,DIMSUB>& range) const { return reg.integral_subrange(range); }
-        Function(Region<Float,Rule,DIM,VT>&& r) : reg(std::forward<Region<Float,Rule,DIM,VT>>(r)) {}
+        Function(Region<Float,Rule,DIM,VT>&& r) : reg(std::forward<Region<Float,Rule,DIM,VT>>(r)), approximation(reg.polynomial()) {}
     };
 
 public:
@@ -148,24 +153,22 @@ class ControlVariateQuadratureAdaptive {
     template<typename R>
     class Function {
         std::vector<R> regions;
+        RegionTree<R> tree;
+        ApproximationCache<R> approximations;
     public:
+        //Points outside the range extrapolate the closest region
         template<typename Float>
         typename R::value_type operator()(const std::array<Float,R::dimensions>& x) const {
-            for (const auto& r : regions) if (r.range().is_inside(x)) return r.approximation_at(x);
-            //Default behavior: extrapolate first region if it is outside all of them
-            return regions.front().approximation_at(x);
+            return approximations(regions,tree.locate(x),x);
         }
         template<typename F, typename Float, std::size_t DIM>
         typename R::value_type integral(const F& f, const Range<Float,DIM>& range) const {
-            auto sol = regions.front().integral_subrange(range.intersection(regions.front().range()));
-            for (auto it = regions.begin()+1; it != regions.end(); ++it)
-                sol += (*it).integral_subrange(range.intersection((*it).range()));
-            return sol;
+            return tree.integral_subrange(regions,range);
         }
 
         const std::vector<R>& get_regions() const { return regions; }
 
-        Function(std::vector<R>&& rs) : regions(std::forward<std::vector<R>>(rs)) { }
+        Function(std::vector<R>&& rs) : regions(std::forward<std::vector<R>>(rs)), tree(regions), approximations(regions) { }
     };
 
     template<typename R>
@@ -175,7 +178,7 @@ public:
     auto operator()(const F& f, const Range<Float,DIM>& range) const {
         auto regions = stepper.init(f,range);
         for (unsigned long i = 0; i<adaptive_iterations;++i) stepper.step(f,range,regions);
-        return function(std::move(regions));
+        return function(std::move(regions).regions());
     }
 
     ControlVariateQuadratureAdaptive(Nested&& nested, Error&& error, unsigned long ai) :
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cmath>
+#include <type_traits>
+#include "range.h"
+#include "batch.h"
+#include "region.h"
+
+namespace viltrum {
+
+/**
+ * Genz-Malik embedded cubature rule for hypercubes: a degree 7 rule with an embedded degree 5 rule (Genz and
+ * Malik, 1980). Its nodes are not a tensor product, so a region needs 2^DIM + 2DIM^2 + 2DIM + 1 evaluations
+ * (57 in 4D and 149 in 6D, against 625 and 15625 with nested(boole,simpson)), which makes it the rule of choice for
+ * DIM >= 4. It is used as any nested rule, for instance
+ *
+ *     integrator_adaptive_iterations(genz_malik(),iterations)
+ *
+ * and its regions are RegionGenzMalik.
+ **/
+class GenzMalik {
+public:
+    template<std::size_t DIM>
+    static constexpr std::size_t nodes() { return (std::size_t(1)<<DIM) + 2*DIM*DIM + 2*DIM + 1; }
+
+    static constexpr double lambda2 = 0.358568582800318091990645153907937; //sqrt(9/70)
+    static constexpr double lambda3 = 0.948683298050513799599668063329815; //sqrt(9/10)
+    static constexpr double lambda5 = 0.688247201611685297721628734293623; //sqrt(9/19)
+};
+
+inline GenzMalik genz_malik() { return GenzMalik(); }
+
+namespace detail {
+inline double genz_malik_norm(float v) { return std::abs(v); }
+inline double genz_malik_norm(double v) { return std::abs(v); }
+template<typename V>
+double genz_malik_norm(const V& v) {
+    double s = 0;
+    for (const auto& x : v) s += genz_malik_norm(x);
+    return s;
+}
+}
+
+/**
+ * Region integrated with the Genz-Malik rule. The error is the difference between the degree 7 and the degree 5
+ * rules, and it is assigned to the dimension with the largest fourth difference of the integrand (or the widest one,
+ * on ties), so the adaptive steppers split that dimension. Only a few values are kept from the evaluations: the
+ * estimates and a separable quadratic model of the integrand along each axis (through the center and the closest
+ * nodes), shifted so that it integrates exactly to the integral of the region. The model is the approximation used
+ * by approximation_at and integral_subrange, so control variates remain unbiased.
+ **/
+template<typename Float, std::size_t DIM, typename VT>
+class RegionGenzMalik {
+    Range<Float,DIM> _range;
+
+public:
+    using value_type = VT;
+    static constexpr std::size_t dimensions = DIM;
+    const Range<Float,DIM>& range() const { return _range; }
+
+private:
+    value_type integral_;
+    value_type low_integral_;
+    std::array<value_type,DIM> errors_;
+    //Model on [-1,1]^DIM: constant_ + sum_i (linear_[i]*t_i + quadratic_[i]*t_i^2)
+    value_type constant_;
+    std::array<value_type,DIM> linear_;
+    std::array<value_type,DIM> quadratic_;
+
+    //Nodes on [-1,1]^DIM: the center, -+lambda2 and -+lambda3 on each axis, (-+lambda3,-+lambda3) on each pair of
+    //axes and (-+lambda5,...,-+lambda5) on all the corners, in this order
+    static const std::vector<std::array<Float,DIM>>& nodes() {
+        static const std::vector<std::array<Float,DIM>> t = [] () {
+            std::vector<std::array<Float,DIM>> t; t.reserve(GenzMalik::nodes<DIM>());
+            std::array<Float,DIM> center; center.fill(Float(0));
+            t.push_back(center);
+            for (double lambda : {GenzMalik::lambda2, GenzMalik::lambda3})
+                for (std::size_t i = 0; i<DIM; ++i)
+                    for (double s : {-1.0,1.0}) { auto p = center; p[i] = Float(s*lambda); t.push_back(p); }
+            for (std::size_t i = 0; i<DIM; ++i)
+                for (std::size_t j = i+1; j<DIM; ++j)
+                    for (double si : {-1.0,1.0}) for (double sj : {-1.0,1.0}) {
+                        auto p = center; p[i] = Float(si*GenzMalik::lambda3); p[j] = Float(sj*GenzMalik::lambda3); t.push_back(p);
+                    }
+            for (std::size_t c = 0; c<(std::size_t(1)<<DIM); ++c) {
+                std::array<Float,DIM> p;
+                for (std::size_t i = 0; i<DIM; ++i) p[i] = Float(((c>>i)&1)?GenzMalik::lambda5:-GenzMalik::lambda5);
+                t.push_back(p);
+            }
+            return t;
+        }();
+        return t;
+    }
+
+    static constexpr std::size_t axis(std::size_t lambda, std::size_t i, std::size_t side) { return 1 + 2*DIM*lambda + 2*i + side; }
+
+    template<typename F>
+    void evaluate(const F& f) {
+        const auto& t = nodes();
+        std::vector<std::array<Float,DIM>> points(t.size());
+        for (std::size_t j = 0; j<t.size(); ++j)
+            for (std::size_t i = 0; i<DIM; ++i)
+                points[j][i] = Float(0.5)*(range().min(i) + range().max(i)) + t[j][i]*Float(0.5)*(range().max(i) - range().min(i));
+        std::vector<value_type> values;
+        evaluate_batch(f,points,values);
+        compute(values);
+    }
+
+    void compute(const std::vector<value_type>& v) {
+        constexpr double n = double(DIM);
+        constexpr double w1 = (12824.0 - 9120.0*n + 400.0*n*n)/19683.0, w2 = 980.0/6561.0, w3 = (1820.0 - 400.0*n)/19683.0,
+                         w4 = 200.0/19683.0, w5 = 6859.0/19683.0/double(std::size_t(1)<<DIM);
+        constexpr double e1 = (729.0 - 950.0*n + 50.0*n*n)/729.0, e2 = 245.0/486.0, e3 = (265.0 - 100.0*n)/1458.0, e4 = 25.0/729.0;
+        constexpr double ratio = (GenzMalik::lambda2*GenzMalik::lambda2)/(GenzMalik::lambda3*GenzMalik::lambda3);
+
+        const value_type& f0 = v[0];
+        const value_type zero = Float(0)*f0;
+        value_type s2 = zero, s3 = zero, s4 = zero, s5 = zero;
+        std::array<double,DIM> fourth_difference;
+        for (std::size_t i = 0; i<DIM; ++i) {
+            const value_type& a2 = v[axis(0,i,0)]; const value_type& b2 = v[axis(0,i,1)];
+            const value_type& a3 = v[axis(1,i,0)]; const value_type& b3 = v[axis(1,i,1)];
+            s2 = s2 + a2 + b2; s3 = s3 + a3 + b3;
+            value_type second2 = a2 + b2 - Float(2)*f0, second3 = a3 + b3 - Float(2)*f0;
+            fourth_difference[i] = detail::genz_malik_norm(second2 - Float(ratio)*second3);
+            linear_[i] = Float(0.5/GenzMalik::lambda2)*(b2 - a2);
+            quadratic_[i] = Float(0.5/(GenzMalik::lambda2*GenzMalik::lambda2))*second2;
+        }
+        const std::size_t first4 = 1 + 4*DIM, first5 = first4 + 2*DIM*(DIM-1);
+        for (std::size_t j = first4; j<first5; ++j) s4 = s4 + v[j];
+        for (std::size_t j = first5; j<v.size(); ++j) s5 = s5 + v[j];
+
+        const Float vol = range().volume();
+        integral_ = vol*(Float(w1)*f0 + Float(w2)*s2 + Float(w3)*s3 + Float(w4)*s4 + Float(w5)*s5);
+        low_integral_ = vol*(Float(e1)*f0 + Float(e2)*s2 + Float(e3)*s3 + Float(e4)*s4);
+
+        constant_ = (Float(1)/vol)*integral_;
+        for (std::size_t i = 0; i<DIM; ++i) constant_ = constant_ - Float(1.0/3.0)*quadratic_[i];
+
+        //The whole error goes to the dimension with the largest fourth difference, ties broken by width
+        double max_difference = 0, max_width = 0;
+        for (std::size_t i = 0; i<DIM; ++i) {
+            max_difference = std::max(max_difference,fourth_difference[i]);
+            max_width = std::max(max_width,double(range().max(i) - range().min(i)));
+        }
+        std::size_t split = 0; double max_score = -1;
+        for (std::size_t i = 0; i<DIM; ++i) {
+            double score = ((max_difference>0)?(fourth_difference[i]/max_difference):0.0) + 1.e-9*double(range().max(i) - range().min(i))/max_width;
+            if (score > max_score) { max_score = score; split = i; }
+        }
+        for (std::size_t i = 0; i<DIM; ++i) errors_[i] = zero;
+        errors_[split] = integral_ - low_integral_;
+    }
+
+    Float volume_from(std::size_t start) const {
+        Float v(1);
+        for (std::size_t i = start; i<DIM; ++i) v*=std::abs(range().max(i) - range().min(i));
+        return v;
+    }
+
+    RegionGenzMalik(const Range<Float,DIM>& r) : _range(r) { }
+
+public:
+    template<typename F>
+    RegionGenzMalik(const F& f, const GenzMalik& q, const Range<Float,DIM>& r) : _range(r) { evaluate(f); }
+
+    GenzMalik quadrature_rule() const { return GenzMalik(); }
+
+    value_type integral() const { return integral_; }
+    value_type error() const { return integral_ - low_integral_; }
+    value_type error(std::size_t dim) const { return errors_[dim]; }
+    const std::array<value_type,DIM>& errors() const { return errors_; }
+
+    //If you do not reach the end it integrates in the other dimensions
+    template<std::size_t DIMSUB>
+    value_type approximation_at(const std::array<Float,DIMSUB>& pos) const {
+        static_assert(DIM>=DIMSUB,"Cannot approximate with bigger number of dimensions than the region");
+        value_type s = constant_;
+        for (std::size_t i = 0; i<DIMSUB; ++i) {
+            Float t = Float(2)*(pos[i] - range().min(i))/(range().max(i) - range().min(i)) - Float(1);
+            s = s + t*linear_[i] + (t*t)*quadratic_[i];
+        }
+        for (std::size_t i = DIMSUB; i<DIM; ++i) s = s + Float(1.0/3.0)*quadratic_[i];
+        return volume_from(DIMSUB)*s;
+    }
+
+    value_type approximation_at(Float pos) const {
+        return approximation_at(std::array<Float,1>{pos});
+    }
+
+    template<std::size_t DIMSUB>
+    value_type integral_subrange(const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b) const {
+        static_assert(DIM>=DIMSUB,"Cannot calculate the subrange integral for that many dimensions, as the region has less dimensions");
+        value_type s = constant_;
+        Float fraction(1);
+        for (std::size_t i = 0; i<DIMSUB; ++i) {
+            Float ta = Float(2)*(a[i] - range().min(i))/(range().max(i) - range().min(i)) - Float(1);
+            Float tb = Float(2)*(b[i] - range().min(i))/(range().max(i) - range().min(i)) - Float(1);
+            fraction *= Float(0.5)*(tb - ta);
+            s = s + (Float(0.5)*(ta + tb))*linear_[i] + ((ta*ta + ta*tb + tb*tb)/Float(3))*quadratic_[i];
+        }
+        for (std::size_t i = DIMSUB; i<DIM; ++i) s = s + Float(1.0/3.0)*quadratic_[i];
+        return (range().volume()*fraction)*s;
+    }
+
+    template<std::size_t DIMSUB>
+    value_type integral_subrange(const Range<Float,DIMSUB>& subrange) const {
+        return integral_subrange(subrange.min(),subrange.max());
+    }
+
+    value_type integral_subrange(Float a, Float b) const {
+        return integral_subrange(std::array<Float,1>{a},std::array<Float,1>{b});
+    }
+
+    template<typename F>
+    std::vector<RegionGenzMalik> split(const F& f, std::size_t dimension = 0, std::size_t parts = 2) const {
+        std::vector<RegionGenzMalik> sol; sol.reserve(parts);
+        std::array<Float,DIM> range_midmin = range().min();
+        std::array<Float,DIM> range_midmax = range().max();
+        Float d = (range().max(dimension) - range().min(dimension))/(Float(parts));
+        for (std::size_t i = 0; i<parts; ++i) {
+            range_midmax[dimension] = (i<(parts-1))?(range().min(dimension)+d*(i+1)):range().max(dimension);
+            sol.emplace_back(f,GenzMalik(),Range<Float,DIM>(range_midmin,range_midmax));
+            range_midmin[dimension] = range_midmax[dimension];
+        }
+        return sol;
+    }
+
+    //Checkpointing (see checkpoint.h): the estimates and the model are stored, as the node values are not kept
+    template<typename Out>
+    void save(Out& out) const {
+        out.write(range()); out.write(integral_); out.write(low_integral_); out.write(errors_);
+        out.write(constant_); out.write(linear_); out.write(quadratic_);
+    }
+
+    template<typename In>
+    static RegionGenzMalik load(In& in, const GenzMalik& q) {
+        RegionGenzMalik r(in.template read<Range<Float,DIM>>());
+        in.read(r.integral_); in.read(r.low_integral_); in.read(r.errors_);
+        in.read(r.constant_); in.read(r.linear_); in.read(r.quadratic_);
+        return r;
+    }
+};
+
+template<typename Float, typename F, std::size_t DIM>
+auto region(const F& f, const GenzMalik& q,
+			const std::array<Float, DIM>& range_min,
+			const std::array<Float, DIM>& range_max) {
+	return RegionGenzMalik<Float,DIM,std::decay_t<decltype(f(range_min))>>(f,q,Range<Float,DIM>(range_min,range_max));
+}
+
+template<typename Float, typename F, std::size_t DIM>
+auto region(const F& f, const GenzMalik& q, const Range<Float,DIM> range) {
+	return RegionGenzMalik<Float,DIM,std::decay_t<decltype(f(range.min()))>>(f,q,range);
+}
+
+}
@@ -3,6 +3,9 @@
 #include "integrate-bins-adaptive.h"
 #include "monte-carlo.h"
 #include "sample-vector.h"
+#include "bin-index.h"
+#include "tensor-horner.h"
+#include <cmath>
 
 namespace viltrum {
 
@@ -18,7 +21,7 @@ class StepperBinsAdaptiveStratifiedControlVariatesPrecalculate {
         ResData residual_data;
         std::vector<const R*> regions;
         std::vector<Range<Float,DIM>> regions_subrange;
-        using Sampler = decltype(std::declval<VectorSampler>()(std::declval<std::vector<R*>>()));
+        using Sampler = decltype(std::declval<VectorSampler>()(std::declval<const std::vector<const R*>&>()));
         Sampler sampler;
         BinData() { }
     };
@@ -26,6 +29,7 @@ class StepperBinsAdaptiveStratifiedControlVariatesPrecalculate {
 	template<typename R, typename Float, std::size_t DIM, std::size_t DIMBINS, typename ResData>
     struct Data {
 		std::vector<R> regions;
+		ApproximationCache<R> approximations;
         vector_dimensions<BinData<R,ResData,Float,DIM>,DIMBINS> bin_data;
         Data(std::vector<R>&& rs, const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range) : 
 			regions(std::forward<std::vector<R>>(rs)),
@@ -37,17 +41,29 @@ public:
         auto regions = cv_stepper.init(resolution,f,range);
         using R = typename decltype(regions)::value_type;
         using ResData = decltype(residual_stepper.init(f,range));
-        Data<R,Float,DIM,DIMBINS,ResData> data(std::move(regions),resolution,range);
+        Data<R,Float,DIM,DIMBINS,ResData> data(std::move(regions).regions(),resolution,range);
         for (unsigned long i = 0; i<adaptive_iterations; ++i)
             cv_stepper.step(resolution,f,range,data.regions);
+        data.approximations = approximation_cache(data.regions);
 
         std::array<Float,DIMBINS> drange;
         for (std::size_t i=0;i<DIMBINS;++i) drange[i] = (range.max(i) - range.min(i))/Float(resolution[i]);
+        //Candidate regions per bin (conservatively rounded), which are then checked for actual intersection
+        auto candidates = bin_index(resolution, data.regions.size(), [&] (std::size_t r) {
+            std::array<std::size_t,DIMBINS> start_bin, end_bin;
+            for (std::size_t i = 0; i<DIMBINS;++i) {
+                start_bin[i] = std::min(resolution[i]-1,std::size_t(std::max(Float(0),(data.regions[r].range().min(i) - range.min(i))/drange[i])));
+                if (start_bin[i]>0) --start_bin[i];
+                end_bin[i]   = std::max(start_bin[i]+1,std::min(resolution[i],std::size_t(std::ceil((data.regions[r].range().max(i) - range.min(i))/drange[i]))+1));
+            }
+            return multidimensional_range(start_bin, end_bin);
+        });
         for (auto pos : multidimensional_range(resolution)) {
            Range<Float,DIM> subrange = range;
            for (std::size_t i=0;i<DIMBINS;++i)
                subrange = subrange.subrange_dimension(i,range.min(i)+pos[i]*drange[i],range.min(i)+(pos[i]+1)*drange[i]);
-           for (const R& r : data.regions) {
+           for (std::size_t c : candidates[pos]) {
+                const R& r = data.regions[c];
                 Range<Float,DIM> inter = subrange.intersection(r.range());
                 if (inter.volume()>0) {
                     data.bin_data[pos].regions.push_back(&r);
@@ -66,9 +82,8 @@ public:
        for (auto pos : multidimensional_range(resolution)) {
 			std::size_t index; Float probability;
 			std::tie(index, probability)  = data.bin_data[pos].sampler.sample();
-			const R* chosen_region = data.bin_data[pos].regions[index];
-			chosen_region = data.bin_data[pos].regions[index];
-			residual_stepper.step([&] (const std::array<Float,DIM>& x) { return (f(x) - chosen_region->approximation_at(x))/probability; },
+			std::size_t chosen = std::size_t(data.bin_data[pos].regions[index] - data.regions.data());
+			residual_stepper.step([&] (const std::array<Float,DIM>& x) { return (f(x) - data.approximations(data.regions,chosen,x))/probability; },
 			    data.bin_data[pos].regions_subrange[index], data.bin_data[pos].residual_data);
        }
     }
@@ -80,6 +95,9 @@ public:
             bins(pos) += data.bin_data.size()*residual_stepper.integral(f,range,data.bin_data[pos].residual_data);
     }
 	
+	//Independent streams for the residual stepper and the vector sampler (see reseed.h)
+	void reseed(std::uint64_t seed) { reseed_random(residual_stepper,stream_seed(seed,0)); reseed_random(vector_sampler,stream_seed(seed,1)); }
+
 	StepperBinsAdaptiveStratifiedControlVariatesPrecalculate(
 		Nested&& nested, Error&& error, ResidualStepper&& rs, VectorSampler&& vs, unsigned long ai) :
 			cv_stepper(std::forward<Nested>(nested), std::forward<Error>(error)),
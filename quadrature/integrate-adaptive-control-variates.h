@@ -3,6 +3,8 @@
 #include "integrate-bins-adaptive.h"
 #include "monte-carlo.h"
 #include "sample-vector.h"
+#include "bin-index.h"
+#include "tensor-horner.h"
 
 #if (__cplusplus < 201703L)
 namespace std {
@@ -22,12 +24,13 @@ class StepperAdaptiveControlVariates {
     
 	template<typename R,typename ResData,typename Sampler>
     struct Data {
-		std::vector<R> regions;
+		AdaptiveHeap<R> regions;
 		ResData residual_data;
 		Sampler vector_sampler;
 		unsigned long cv_iterations;
-        Data(std::vector<R>&& rs, ResData&& rd, Sampler&& vs) : 
-			regions(std::forward<std::vector<R>>(rs)),
+		ApproximationCache<R> approximations; //Rebuilt (not checkpointed) when the residual phase starts
+        Data(AdaptiveHeap<R>&& rs, ResData&& rd, Sampler&& vs) : 
+			regions(std::forward<AdaptiveHeap<R>>(rs)),
 			residual_data(std::forward<ResData>(rd)),
 			vector_sampler(std::forward<Sampler>(vs)),
 			cv_iterations(0) { }
@@ -62,13 +65,14 @@ public:
 		} else {
 			if (data.cv_iterations == adaptive_iterations) {
 				data.vector_sampler = vector_sampler(data.regions);
+				data.approximations = approximation_cache(data.regions);
 				++data.cv_iterations;
 			}
 			std::size_t index; Float probability;
 			std::tie(index, probability)  = data.vector_sampler.sample();
 			const R& chosen_region = data.regions[index];
 			residual_stepper.step([&] (const std::array<Float,DIM>& x)
-		      { return (f(x) - chosen_region.approximation_at(x))/probability; },
+		      { return (f(x) - data.approximations(data.regions,index,x))/probability; },
 			  chosen_region.range(), data.residual_data);
 		}
     }
@@ -78,6 +82,37 @@ public:
         return cv_stepper.integral(f,range,data.regions) +
 				residual_stepper.integral(f,range,data.residual_data);
     }
+
+	//Checkpointing (see checkpoint.h), if the residual stepper supports it
+	template<typename Out, typename R,typename ResData,typename Sampler>
+    void checkpoint(Out& out, const Data<R,ResData,Sampler>& data) const {
+		cv_stepper.checkpoint(out,data.regions);
+		residual_stepper.checkpoint(out,data.residual_data);
+		out.write(data.vector_sampler);
+		out.write(data.cv_iterations);
+	}
+
+	template<typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const F& f, const Range<Float,DIM>& range) const {
+		using D = decltype(init(f,range));
+		auto regions = cv_stepper.resume(in,f,range);
+		auto residual_data = residual_stepper.resume(in,f,range);
+		decltype(std::declval<D>().vector_sampler) sampler;
+		in.read(sampler);
+		D data(std::move(regions),std::move(residual_data),std::move(sampler));
+		in.read(data.cv_iterations);
+		if (data.cv_iterations > adaptive_iterations) data.approximations = approximation_cache(data.regions);
+		return data;
+	}
+
+	//The generators of the residual stepper and the vector sampler
+	template<typename Out>
+	void save(Out& out) const { out.write_state(residual_stepper); out.write_state(vector_sampler); }
+	template<typename In>
+	void load(In& in) { in.read_state(residual_stepper); in.read_state(vector_sampler); }
+
+	//Independent streams for the residual stepper and the vector sampler (see reseed.h)
+	void reseed(std::uint64_t seed) { reseed_random(residual_stepper,stream_seed(seed,0)); reseed_random(vector_sampler,stream_seed(seed,1)); }
 	
 	StepperAdaptiveControlVariates(
 		Nested&& nested, Error&& error, ResidualStepper&& rs, VectorSampler&& vs, unsigned long ai) :
@@ -142,6 +177,7 @@ class StepperBinsAdaptiveControlVariates {
 		ResData residual_data;
 		Sampler vector_sampler;
 		unsigned long cv_iterations;
+		ApproximationCache<R> approximations; //Rebuilt (not checkpointed) when the residual phase starts
         Data(std::vector<R>&& rs, ResData&& rd, Sampler&& vs) : 
 			regions(std::forward<std::vector<R>>(rs)),
 			residual_data(std::forward<ResData>(rd)),
@@ -160,13 +196,14 @@ public:
 		auto init = residual_stepper.init(resolution,f, range);
 
 		using VECTOR_TYPE = typename decltype(regions)::value_type;
+		auto sampler = vector_sampler(regions.regions());
 
 		return Data<VECTOR_TYPE, 
 					decltype(init), 
-					decltype(vector_sampler(regions))>
-					(std::move(regions),
+					decltype(sampler)>
+					(std::move(regions).regions(),
 					std::move(init),
-					vector_sampler(regions));
+					std::move(sampler));
     }
 	
 	template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename R,typename ResData,typename Sampler>
@@ -178,26 +215,57 @@ public:
 		} else {
 			if (data.cv_iterations == adaptive_iterations) {
 				data.vector_sampler = vector_sampler(data.regions);
+				data.approximations = approximation_cache(data.regions);
 				++data.cv_iterations;
 			}
             std::size_t index; Float probability;
 			std::tie(index, probability)  = data.vector_sampler.sample();
 			const R& chosen_region = data.regions[index];
 			residual_stepper.step(resolution,[&] (const std::array<Float,DIM>& x)
-		      { return (f(x) - chosen_region.approximation_at(x))/probability; },
+		      { return (f(x) - data.approximations(data.regions,index,x))/probability; },
 			  chosen_region.range(), data.residual_data);
 		}
     }
 	
 	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename R,typename ResData,typename Sampler>
     void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Data<R,ResData,Sampler>& data) const {
-        vector_dimensions<decltype(f(range.min())),DIMBINS> bins_cv(resolution);
+        //The control variate adds to the bins, so only the residual needs a buffer
         vector_dimensions<decltype(f(range.min())),DIMBINS> bins_residual(resolution);
-        cv_stepper.integral(bins_cv,resolution,f,range,data.regions);
         residual_stepper.integral(bins_residual,resolution,f,range,data.residual_data);
         for (auto pos : multidimensional_range(resolution))
-            bins(pos) = bins_cv[pos]+bins_residual[pos];
+            bins(pos) = bins_residual[pos];
+        cv_stepper.integral(bins,resolution,f,range,data.regions);
     }
+
+	//Checkpointing (see checkpoint.h), if the residual stepper supports it
+	template<typename Out, typename R,typename ResData,typename Sampler>
+    void checkpoint(Out& out, const Data<R,ResData,Sampler>& data) const {
+		cv_stepper.checkpoint(out,data.regions);
+		residual_stepper.checkpoint(out,data.residual_data);
+		out.write(data.vector_sampler);
+		out.write(data.cv_iterations);
+	}
+
+	template<std::size_t DIMBINS, typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+		using D = decltype(init(resolution,f,range));
+		auto regions = cv_stepper.resume(in,resolution,f,range);
+		auto residual_data = residual_stepper.resume(in,resolution,f,range);
+		decltype(std::declval<D>().vector_sampler) sampler;
+		in.read(sampler);
+		D data(std::move(regions).regions(),std::move(residual_data),std::move(sampler));
+		in.read(data.cv_iterations);
+		if (data.cv_iterations > adaptive_iterations) data.approximations = approximation_cache(data.regions);
+		return data;
+	}
+
+	template<typename Out>
+	void save(Out& out) const { out.write_state(residual_stepper); out.write_state(vector_sampler); }
+	template<typename In>
+	void load(In& in) { in.read_state(residual_stepper); in.read_state(vector_sampler); }
+
+	//Independent streams for the residual stepper and the vector sampler (see reseed.h)
+	void reseed(std::uint64_t seed) { reseed_random(residual_stepper,stream_seed(seed,0)); reseed_random(vector_sampler,stream_seed(seed,1)); }
 	
 	StepperBinsAdaptiveControlVariates(
 		Nested&& nested, Error&& error, ResidualStepper&& rs, VectorSampler&& vs, unsigned long ai) :
@@ -230,8 +298,7 @@ class StepperBinsAdaptiveStratifiedControlVariates {
     template<typename R, typename ResData, typename Float, std::size_t DIM>
     struct BinData {
         ResData residual_data;
-        std::vector<const R*> regions;
-        using Sampler = decltype(std::declval<VectorSampler>()(std::declval<std::vector<R*>>()));
+        using Sampler = decltype(std::declval<VectorSampler>()(std::declval<const std::vector<R>&>()));
         Sampler sampler;
         BinData() { }
     };
@@ -239,9 +306,11 @@ class StepperBinsAdaptiveStratifiedControlVariates {
 	template<typename R, typename Float, std::size_t DIM, std::size_t DIMBINS, typename ResData>
     struct Data {
 		std::vector<R> regions;
+		ApproximationCache<R> approximations;
+		BinIndex<DIMBINS> regions_per_bin;
         vector_dimensions<BinData<R,ResData,Float,DIM>,DIMBINS> bin_data;
-        Data(std::vector<R>&& rs, const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range) : 
-			regions(std::forward<std::vector<R>>(rs)),
+        Data(std::vector<R>&& rs, BinIndex<DIMBINS>&& index, const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range) : 
+			regions(std::forward<std::vector<R>>(rs)), approximations(regions), regions_per_bin(std::move(index)),
             bin_data(resolution) { }
     };
 
@@ -251,23 +320,20 @@ public:
         auto regions = cv_stepper.init(resolution,f,range);
         using R = typename decltype(regions)::value_type;
         using ResData = decltype(residual_stepper.init(f,range));
-        Data<R,Float,DIM,DIMBINS,ResData> data(std::move(regions),resolution,range);
         for (unsigned long i = 0; i<adaptive_iterations; ++i)
-            cv_stepper.step(resolution,f,range,data.regions);
+            cv_stepper.step(resolution,f,range,regions);
 
         std::array<Float,DIMBINS> drange;
         for (std::size_t i=0;i<DIMBINS;++i) drange[i] = (range.max(i) - range.min(i))/Float(resolution[i]);
-		for (const auto& r : data.regions) {
+        auto index = bin_index(resolution, regions.size(), [&] (std::size_t r) {
             std::array<std::size_t,DIMBINS> start_bin, end_bin;
             for (std::size_t i = 0; i<DIMBINS;++i) {
-                start_bin[i] = std::max(std::size_t(0),std::size_t((r.range().min(i) - range.min(i))/drange[i]));
-                end_bin[i]   = std::min(resolution[i],std::size_t(0.99f + (r.range().max(i) - range.min(i))/drange[i]));
+                start_bin[i] = std::max(std::size_t(0),std::size_t((regions[r].range().min(i) - range.min(i))/drange[i]));
+                end_bin[i]   = std::min(resolution[i],std::size_t(0.99f + (regions[r].range().max(i) - range.min(i))/drange[i]));
             }
-
-//            if (start_bin == end_bin) data.bin_data[start_bin].regions.push_back(&r); else 
-            for (auto pos : multidimensional_range(start_bin, end_bin)) 
-                data.bin_data[pos].regions.push_back(&r);
-		}
+            return multidimensional_range(start_bin, end_bin);
+        });
+        Data<R,Float,DIM,DIMBINS,ResData> data(std::move(regions).regions(),std::move(index),resolution,range);
 
 
         for (auto pos : multidimensional_range(resolution)) {
@@ -277,7 +343,7 @@ public:
 				submax[i] = range.min(i)+(pos[i]+1)*drange[i];
 			}
 			Range<Float, DIMBINS> pixel_range(submin,submax);
-			data.bin_data[pos].sampler = vector_sampler(data.bin_data[pos].regions);
+			data.bin_data[pos].sampler = vector_sampler(bin_items(data.regions,data.regions_per_bin[pos]));
 			data.bin_data[pos].residual_data = residual_stepper.init(f,pixel_range.intersection_large(range));
         }
         return data;
@@ -291,14 +357,15 @@ public:
 		for (auto pos : multidimensional_range(resolution)) {
             std::size_t index; Float probability;
 			std::tie(index, probability) = data.bin_data[pos].sampler.sample();
-			const R* chosen_region = data.bin_data[pos].regions[index];
+			std::size_t chosen = data.regions_per_bin[pos][index];
+			const R* chosen_region = &data.regions[chosen];
 			std::array<Float, DIMBINS> submin, submax;
             for (std::size_t i=0;i<DIMBINS;++i) {
                 submin[i] = range.min(i)+pos[i]*drange[i];
                 submax[i] = range.min(i)+(pos[i]+1)*drange[i];
             }
 			Range<Float, DIMBINS> pixel_range(submin,submax);
-			residual_stepper.step([&] (const std::array<Float,DIM>& x) -> decltype(f(x)) { return (f(x) - chosen_region->approximation_at(x))/probability; },
+			residual_stepper.step([&] (const std::array<Float,DIM>& x) -> decltype(f(x)) { return (f(x) - data.approximations(data.regions,chosen,x))/probability; },
 			    pixel_range.intersection_large(chosen_region->range()), data.bin_data[pos].residual_data);
 		}
     }
@@ -310,6 +377,9 @@ public:
             bins(pos) += double(data.bin_data.size())*residual_stepper.integral(f,range,data.bin_data[pos].residual_data);
     }
 	
+	//Independent streams for the residual stepper and the vector sampler (see reseed.h)
+	void reseed(std::uint64_t seed) { reseed_random(residual_stepper,stream_seed(seed,0)); reseed_random(vector_sampler,stream_seed(seed,1)); }
+
 	StepperBinsAdaptiveStratifiedControlVariates(
 		Nested&& nested, Error&& error, ResidualStepper&& rs, VectorSampler&& vs, unsigned long ai) :
 			cv_stepper(std::forward<Nested>(nested), std::forward<Error>(error)),
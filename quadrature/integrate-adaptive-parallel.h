@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+#include <type_traits>
+#include "integrate.h"
+#include "integrate-bins-adaptive.h"
+#include "../utils/parallel.h"
+
+namespace viltrum {
+
+/**
+ * Adaptive stepper that, on each step, pops the regions_per_step regions with the highest error from the heap,
+ * splits them (evaluating the integrand) in parallel and pushes all the subregions back. The subregions are pushed in
+ * the same order in which their parents were popped, so the result only depends on regions_per_step and never on the
+ * number of threads. With regions_per_step = 1 it behaves exactly as StepperAdaptive.
+ *
+ * The integrand is called concurrently from several threads, so it should be thread-safe.
+ */
+template<typename N, typename Error>
+class StepperAdaptiveParallel {
+    StepperAdaptive<N,Error> adaptive;
+    Error error;
+    std::size_t regions_per_step;
+    std::size_t nthreads;
+
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range) const {
+        return adaptive.init(f,range);
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    void step(const F& f, const Range<Float,DIM>& range, AdaptiveHeap<R>& heap) const {
+        std::size_t k = std::min(regions_per_step,heap.size());
+        std::vector<R> popped; popped.reserve(k);
+        for (std::size_t i = 0; i<k; ++i) popped.push_back(heap.pop());
+        std::vector<std::vector<R>> children(k);
+        parallel_for(k, [&] (std::size_t i, std::size_t thread) {
+            auto subregions = popped[i].split(f,std::get<1>(popped[i].extra()));
+            children[i].reserve(subregions.size());
+            for (auto& sr : subregions) {
+                auto errdim = error(sr);
+                children[i].emplace_back(std::move(sr),std::move(errdim));
+            }
+        }, nthreads);
+        for (auto& c : children) for (auto& sr : c) heap.push(std::move(sr));
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto integral(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.integral();
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto error_estimate(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.error();
+    }
+
+    StepperAdaptiveParallel(N&& n, Error&& e, std::size_t rps, std::size_t nt) :
+        adaptive(std::forward<N>(n),Error(e)), error(std::forward<Error>(e)),
+        regions_per_step(std::max(std::size_t(1),rps)), nthreads(nt) { }
+};
+
+template<typename N, typename Error, typename = std::enable_if_t<!std::is_integral_v<std::decay_t<Error>>>>
+auto stepper_adaptive_parallel(N&& nested, Error&& error, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return StepperAdaptiveParallel<std::decay_t<N>,std::decay_t<Error>>(std::decay_t<N>(std::forward<N>(nested)),std::decay_t<Error>(std::forward<Error>(error)),regions_per_step,nthreads);
+}
+
+template<typename N>
+auto stepper_adaptive_parallel(N&& nested, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return stepper_adaptive_parallel(std::forward<N>(nested), error_single_dimension_standard(), regions_per_step, nthreads);
+}
+
+//Each iteration splits regions_per_step regions, so the cost is proportional to iterations*regions_per_step
+template<typename N, typename Error, typename = std::enable_if_t<!std::is_integral_v<std::decay_t<Error>>>>
+auto integrator_adaptive_parallel_iterations(N&& nested, Error&& error, unsigned long iterations, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return integrator_stepper(stepper_adaptive_parallel(std::forward<N>(nested),std::forward<Error>(error),regions_per_step,nthreads),iterations);
+}
+
+template<typename N>
+auto integrator_adaptive_parallel_iterations(N&& nested, unsigned long iterations, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return integrator_stepper(stepper_adaptive_parallel(std::forward<N>(nested),regions_per_step,nthreads),iterations);
+}
+
+template<typename N, typename Error, typename = std::enable_if_t<!std::is_integral_v<std::decay_t<Error>>>>
+auto stepper_bins_adaptive_parallel(N&& nested, Error&& error, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    using Adaptive = StepperAdaptiveParallel<std::decay_t<N>,std::decay_t<Error>>;
+    return StepperBinsAdaptive<std::decay_t<N>,std::decay_t<Error>,Adaptive>(
+        stepper_adaptive_parallel(std::forward<N>(nested),std::forward<Error>(error),regions_per_step,nthreads));
+}
+
+template<typename N>
+auto stepper_bins_adaptive_parallel(N&& nested, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return stepper_bins_adaptive_parallel(std::forward<N>(nested), error_single_dimension_standard(), regions_per_step, nthreads);
+}
+
+template<typename N, typename Error, typename = std::enable_if_t<!std::is_integral_v<std::decay_t<Error>>>>
+auto integrator_bins_adaptive_parallel(N&& nested, Error&& error, unsigned long iterations, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return integrator_bins_stepper(
+        stepper_bins_adaptive_parallel(std::forward<N>(nested),std::forward<Error>(error),regions_per_step,nthreads),
+    iterations);
+}
+
+template<typename N>
+auto integrator_bins_adaptive_parallel(N&& nested, unsigned long iterations, std::size_t regions_per_step, std::size_t nthreads = default_threads()) {
+    return integrator_bins_stepper(
+        stepper_bins_adaptive_parallel(std::forward<N>(nested),regions_per_step,nthreads),
+    iterations);
+}
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <type_traits>
+#include "integrate.h"
+#include "integrate-bins-adaptive.h"
+#include "region-pool.h"
+
+namespace viltrum {
+
+/**
+ * Same algorithm as StepperAdaptive, but the regions are stored in a RegionPool instead of a std::vector of regions,
+ * which avoids keeping one heap allocation per region and keeps heap operations cheap. Each step still allocates the
+ * temporary region being split and its halves. Results are the same as with StepperAdaptive.
+ */
+template<typename N, typename Error>
+class StepperAdaptivePool {
+    N nested;
+    Error error;
+
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range) const {
+        auto r = region(f,nested,range.min(),range.max());
+        auto errdim = error(r);
+        RegionPool<decltype(r),std::decay_t<decltype(std::get<0>(errdim))>> pool(r.quadrature_rule());
+        pool.push(r,std::get<0>(errdim),std::get<1>(errdim));
+        return pool;
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R, typename Err>
+    void step(const F& f, const Range<Float,DIM>& range, RegionPool<R,Err>& pool) const {
+        std::size_t id = pool.pop();
+        auto subregions = pool.region(id).split(f,pool.split_dimension(id));
+        for (const auto& sr : subregions) {
+            auto errdim = error(sr);
+            pool.push(sr,std::get<0>(errdim),std::get<1>(errdim));
+        }
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R, typename Err>
+    auto integral(const F& f, const Range<Float,DIM>& range, const RegionPool<R,Err>& pool) const {
+        return pool.integral();
+    }
+
+    //Sum of the error estimations of all the regions
+    template<typename F, typename Float, std::size_t DIM, typename R, typename Err>
+    auto error_estimate(const F& f, const Range<Float,DIM>& range, const RegionPool<R,Err>& pool) const {
+        return pool.error();
+    }
+
+    StepperAdaptivePool(N&& n, Error&& e) :
+        nested(std::forward<N>(n)), error(std::forward<Error>(e)) { }
+};
+
+template<typename N, typename Error>
+auto stepper_adaptive_pool(N&& nested, Error&& error) {
+    return StepperAdaptivePool<std::decay_t<N>,std::decay_t<Error>>(std::decay_t<N>(std::forward<N>(nested)),std::decay_t<Error>(std::forward<Error>(error)));
+}
+
+template<typename N>
+auto stepper_adaptive_pool(N&& nested) {
+    return stepper_adaptive_pool(std::forward<N>(nested), error_single_dimension_standard());
+}
+
+template<typename N, typename Error>
+auto integrator_adaptive_pool_iterations(N&& nested, Error&& error, unsigned long iterations) {
+    return integrator_stepper(stepper_adaptive_pool(std::forward<N>(nested),std::forward<Error>(error)),iterations);
+}
+
+template<typename N>
+auto integrator_adaptive_pool_iterations(N&& nested, unsigned long iterations) {
+    return integrator_stepper(stepper_adaptive_pool(std::forward<N>(nested)),iterations);
+}
+
+template<typename N, typename Error>
+auto stepper_bins_adaptive_pool(N&& nested, Error&& error) {
+    using Adaptive = StepperAdaptivePool<std::decay_t<N>,std::decay_t<Error>>;
+    return StepperBinsAdaptive<std::decay_t<N>,std::decay_t<Error>,Adaptive>(
+        stepper_adaptive_pool(std::forward<N>(nested),std::forward<Error>(error)));
+}
+
+template<typename N>
+auto stepper_bins_adaptive_pool(N&& nested) {
+    return stepper_bins_adaptive_pool(std::forward<N>(nested), error_single_dimension_standard());
+}
+
+template<typename N, typename Error>
+auto integrator_bins_adaptive_pool(N&& nested, Error&& error, unsigned long iterations) {
+    return integrator_bins_stepper(stepper_bins_adaptive_pool(std::forward<N>(nested),std::forward<Error>(error)),iterations);
+}
+
+template<typename N>
+auto integrator_bins_adaptive_pool(N&& nested, unsigned long iterations) {
+    return integrator_bins_stepper(stepper_bins_adaptive_pool(std::forward<N>(nested)),iterations);
+}
+
+}
@@ -2,12 +2,13 @@
 
 #include <vector>
 #include "integrate-bins-stepper.h"
+#include "../utils/compensated-sum.h"
 
 namespace viltrum {
 
-template<typename Nested, typename Error>
+template<typename Nested, typename Error, typename Adaptive = StepperAdaptive<Nested,Error>>
 class StepperBinsAdaptive {
-    StepperAdaptive<Nested,Error> adaptive;
+    Adaptive adaptive;
 
 public:
     template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
@@ -15,46 +16,147 @@ public:
         return adaptive.init(f,range);
     }
 
-    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename R>
-    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, std::vector<R>& heap) const {
+    //Warm start from the partition of an earlier integration (see StepperAdaptive)
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Partition>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range,
+            const Partition& partition, double coarsen_error = 0.0, std::size_t nthreads = 1) const {
+        return adaptive.init(f,range,partition,coarsen_error,nthreads);
+    }
+
+    //Regions can be any container of regions (or region-like entries) from the adaptive stepper
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Regions>
+    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Regions& heap) const {
         adaptive.step(f,range,heap);
     }
 
-    template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename R>
-    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const std::vector<R>& regions) const {
+    //Calls op(pos,contribution) for each bin pos that region r overlaps
+    template<std::size_t DIMBINS, typename Float, std::size_t DIM, typename R, typename Op>
+    static void for_each_bin(const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range, const R& r, const Op& op) {
         std::array<Float,DIMBINS> drange;
         for (std::size_t i=0;i<DIMBINS;++i) drange[i] = (range.max(i) - range.min(i))/Float(resolution[i]);
         double factor = 1;
         for (std::size_t i=0;i<DIMBINS;++i) factor*=resolution[i];
 
-        for (const auto& r : regions) {
-            std::array<std::size_t,DIMBINS> start_bin, end_bin;
-            for (std::size_t i = 0; i<DIMBINS;++i) {
-                start_bin[i] = std::max(std::size_t(0),std::size_t((r.range().min(i) - range.min(i))/drange[i]));
-                end_bin[i]   = std::min(resolution[i],std::size_t((r.range().max(i) - range.min(i))/drange[i])+1);
-            }
-            if (start_bin == end_bin) bins(start_bin)+=r.integral();
-            else for (auto pos : multidimensional_range(start_bin, end_bin)) {
-                std::array<Float, DIMBINS> submin, submax;
-//                Range<Float,DIM> subrange = range;
-                for (std::size_t i=0;i<DIMBINS;++i) {
-//                    subrange = subrange.subrange_dimension(i,range.min(i)+pos[i]*drange[i],range.min(i)+(pos[i]+1)*drange[i]);
-                    submin[i] = range.min(i)+pos[i]*drange[i];
-                    submax[i] = range.min(i)+(pos[i]+1)*drange[i];
-                }
-                //The commented stuff should work and does not, we will have to solve it
-//                bins(pos) += factor*r.integral_subrange(subrange.intersection(r.range()));
-                bins(pos) += factor*r.integral_subrange(Range<Float,DIMBINS>(submin,submax).intersection(r.range()));
+        std::array<std::size_t,DIMBINS> start_bin, end_bin;
+        for (std::size_t i = 0; i<DIMBINS;++i) {
+            start_bin[i] = std::max(std::size_t(0),std::size_t((r.range().min(i) - range.min(i))/drange[i]));
+            end_bin[i]   = std::min(resolution[i],std::size_t((r.range().max(i) - range.min(i))/drange[i])+1);
+        }
+        if (start_bin == end_bin) op(start_bin,r.integral());
+        else for (auto pos : multidimensional_range(start_bin, end_bin)) {
+            std::array<Float, DIMBINS> submin, submax;
+//            Range<Float,DIM> subrange = range;
+            for (std::size_t i=0;i<DIMBINS;++i) {
+//                subrange = subrange.subrange_dimension(i,range.min(i)+pos[i]*drange[i],range.min(i)+(pos[i]+1)*drange[i]);
+                submin[i] = range.min(i)+pos[i]*drange[i];
+                submax[i] = range.min(i)+(pos[i]+1)*drange[i];
             }
+            //The commented stuff should work and does not, we will have to solve it
+//            op(pos,factor*r.integral_subrange(subrange.intersection(r.range())));
+            op(pos,factor*r.integral_subrange(Range<Float,DIMBINS>(submin,submax).intersection(r.range())));
         }
     }
 
+    template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Regions>
+    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Regions& regions) const {
+        for (const auto& r : regions)
+            for_each_bin(resolution,range,r,[&bins] (const auto& pos, const auto& v) { bins(pos) += v; });
+    }
+
+    //Sum of the error estimations of all the regions (if the adaptive stepper provides it)
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Regions>
+    auto error_estimate(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Regions& regions) const
+            -> decltype(std::declval<const Adaptive&>().error_estimate(f,range,regions)) {
+        return adaptive.error_estimate(f,range,regions);
+    }
+
+    //Checkpointing (see checkpoint.h), if the adaptive stepper supports it
+    template<typename Out, typename Regions>
+    void checkpoint(Out& out, const Regions& regions) const { adaptive.checkpoint(out,regions); }
+
+    template<typename In, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        return adaptive.resume(in,f,range);
+    }
+
     StepperBinsAdaptive(Nested&& nested, Error&& error) : adaptive(std::forward<Nested>(nested), std::forward<Error>(error)) { }
+    StepperBinsAdaptive(Adaptive&& a) : adaptive(std::forward<Adaptive>(a)) { }
+};
+
+/**
+ * Same as StepperBinsAdaptive, but the bins are kept up to date while stepping: when a region is split, its
+ * contribution to each bin it overlaps is replaced by those of its subregions (with compensated sums, so that the
+ * rounding error does not build up). Each step then costs the bins touched by that split, and integral() copies the
+ * current image in time proportional to the number of bins, so it can be called at any time for progressive previews
+ * (see integrate_bins_stepper_progression). The resolution and range must be the same on every call.
+ **/
+template<typename Nested, typename Error>
+class StepperBinsAdaptiveIncremental {
+    StepperAdaptive<Nested,Error> adaptive;
+
+    template<typename Heap, std::size_t DIMBINS>
+    struct Data {
+        using value_type = decltype(std::declval<const Heap&>().integral());
+        Heap regions;
+        vector_dimensions<CompensatedSum<value_type>,DIMBINS> bins;
+        Data(Heap&& h, const std::array<std::size_t,DIMBINS>& resolution) : regions(std::forward<Heap>(h)), bins(resolution) { }
+    };
+
+    template<typename Heap, std::size_t DIMBINS, typename Float, std::size_t DIM>
+    auto data(Heap&& heap, const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range) const {
+        Data<Heap,DIMBINS> d(std::forward<Heap>(heap),resolution);
+        for (const auto& r : d.regions)
+            StepperBinsAdaptive<Nested,Error>::for_each_bin(resolution,range,r,[&d] (const auto& pos, const auto& v) { d.bins[pos] += v; });
+        return d;
+    }
+
+public:
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        return data(adaptive.init(f,range),resolution,range);
+    }
+
+    //Warm start from the partition of an earlier integration (see StepperAdaptive)
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Partition>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range,
+            const Partition& partition, double coarsen_error = 0.0, std::size_t nthreads = 1) const {
+        return data(adaptive.init(f,range,partition,coarsen_error,nthreads),resolution,range);
+    }
+
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Heap>
+    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Data<Heap,DIMBINS>& data) const {
+        adaptive.step(f,range,data.regions,[&] (const auto& region, const auto& subregions) {
+            StepperBinsAdaptive<Nested,Error>::for_each_bin(resolution,range,region,[&data] (const auto& pos, const auto& v) { data.bins[pos] -= v; });
+            for (const auto& sr : subregions)
+                StepperBinsAdaptive<Nested,Error>::for_each_bin(resolution,range,sr,[&data] (const auto& pos, const auto& v) { data.bins[pos] += v; });
+        });
+    }
+
+    template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Heap>
+    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Data<Heap,DIMBINS>& data) const {
+        for (auto pos : multidimensional_range(resolution)) bins(pos) = data.bins[pos].value();
+    }
+
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Heap>
+    auto error_estimate(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Data<Heap,DIMBINS>& data) const {
+        return adaptive.error_estimate(f,range,data.regions);
+    }
+
+    //Checkpointing (see checkpoint.h): only the regions are stored, and the bins are splatted again on resume
+    template<typename Out, typename Heap, std::size_t DIMBINS>
+    void checkpoint(Out& out, const Data<Heap,DIMBINS>& data) const { adaptive.checkpoint(out,data.regions); }
+
+    template<typename In, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        return data(adaptive.resume(in,f,range),resolution,range);
+    }
+
+    StepperBinsAdaptiveIncremental(Nested&& nested, Error&& error) : adaptive(std::forward<Nested>(nested), std::forward<Error>(error)) { }
 };
 
 template<typename Nested, typename Error>
 auto stepper_bins_adaptive(Nested&& nested, Error&& error) {
-    return StepperBinsAdaptive<std::decay_t<Nested>,std::decay_t<Error>>(std::forward<Nested>(nested), std::forward<Error>(error));
+    return StepperBinsAdaptive<std::decay_t<Nested>,std::decay_t<Error>>(std::decay_t<Nested>(std::forward<Nested>(nested)), std::decay_t<Error>(std::forward<Error>(error)));
 }
 
 template<typename N>
@@ -62,6 +164,16 @@ auto stepper_bins_adaptive(N&& nested) {
     return stepper_bins_adaptive(std::forward<N>(nested), error_single_dimension_standard());
 }
 
+template<typename Nested, typename Error>
+auto stepper_bins_adaptive_incremental(Nested&& nested, Error&& error) {
+    return StepperBinsAdaptiveIncremental<std::decay_t<Nested>,std::decay_t<Error>>(std::decay_t<Nested>(std::forward<Nested>(nested)), std::decay_t<Error>(std::forward<Error>(error)));
+}
+
+template<typename N>
+auto stepper_bins_adaptive_incremental(N&& nested) {
+    return stepper_bins_adaptive_incremental(std::forward<N>(nested), error_single_dimension_standard());
+}
+
 template<typename Nested, typename Error>
 auto integrator_bins_adaptive(Nested&& nested, Error&& error, unsigned long iterations) {
     return integrator_bins_stepper(
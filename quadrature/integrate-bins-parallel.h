@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vector>
+#include <random>
+#include "integrate-bins.h"
+#include "integrate-bins-stepper.h"
+#include "vector-dimensions.h"
+#include "reseed.h"
+#include "../utils/parallel.h"
+
+namespace viltrum {
+
+namespace detail {
+//Position of the i-th bin in the same order as multidimensional_range (first dimension changes faster)
+template<std::size_t DIMBINS>
+std::array<std::size_t,DIMBINS> bin_position(std::size_t i, const std::array<std::size_t,DIMBINS>& resolution) {
+    std::array<std::size_t,DIMBINS> pos;
+    for (std::size_t d = 0; d<DIMBINS; ++d) { pos[d] = i%resolution[d]; i/=resolution[d]; }
+    return pos;
+}
+
+template<std::size_t DIMBINS, typename Float, std::size_t DIM>
+Range<Float,DIM> bin_range(const std::array<std::size_t,DIMBINS>& pos, const std::array<std::size_t,DIMBINS>& resolution, const Range<Float,DIM>& range) {
+    Range<Float,DIM> subrange = range;
+    for (std::size_t i=0;i<DIMBINS;++i) {
+        Float drange = (range.max(i) - range.min(i))/Float(resolution[i]);
+        subrange = subrange.subrange_dimension(i,range.min(i)+pos[i]*drange,range.min(i)+(pos[i]+1)*drange);
+    }
+    return subrange;
+}
+
+template<std::size_t DIMBINS>
+std::size_t bins_count(const std::array<std::size_t,DIMBINS>& resolution) {
+    std::size_t n = 1;
+    for (auto r : resolution) n*=r;
+    return n;
+}
+}
+
+/**
+ * Same as IntegratorBinsPerBin, but the bins are split in tiles of consecutive bins (in the same order as
+ * multidimensional_range) that are integrated by a pool of threads. Each tile uses its own copy of the per bin
+ * integrator, reseeded (see reseed.h) from the seed and the tile index, so the result is the same regardless of
+ * the number of threads. Both the integrand and the bins must support concurrent access (to different bins).
+ **/
+template<typename IntegratorPerBin>
+class IntegratorBinsPerBinParallel {
+    IntegratorPerBin bin_integrator;
+    std::uint64_t seed;
+    std::size_t nthreads;
+    std::size_t tile_size;
+
+public:
+	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution,
+		const F& f, const Range<Float,DIM>& range) const {
+        std::size_t n = detail::bins_count(bin_resolution);
+        double factor(n);
+        parallel_for((n+tile_size-1)/tile_size, [&] (std::size_t tile, std::size_t thread) {
+            auto integrator = reseeded(bin_integrator,stream_seed(seed,tile));
+            for (std::size_t i = tile*tile_size; i<std::min(n,(tile+1)*tile_size); ++i) {
+                auto pos = detail::bin_position(i,bin_resolution);
+                bins(pos) = factor*integrator.integrate(f,detail::bin_range(pos,bin_resolution,range));
+            }
+        }, nthreads);
+	}
+
+    IntegratorBinsPerBinParallel(IntegratorPerBin&& pi, std::uint64_t seed, std::size_t nthreads, std::size_t tile_size) : 
+	    bin_integrator(std::forward<IntegratorPerBin>(pi)), seed(seed), nthreads(nthreads), tile_size(std::max(std::size_t(1),tile_size)) { }
+};
+
+template<typename IntegratorPerBin>
+auto integrator_bins_per_bin_parallel(IntegratorPerBin&& i, std::uint64_t seed = std::random_device()(), std::size_t nthreads = default_threads(), std::size_t tile_size = 64) {
+    return IntegratorBinsPerBinParallel<std::decay_t<IntegratorPerBin>>(std::decay_t<IntegratorPerBin>(std::forward<IntegratorPerBin>(i)),seed,nthreads,tile_size);
+}
+
+/**
+ * Parallel version of StepperBinsPerBin, with the same tiles as IntegratorBinsPerBinParallel. The per bin stepper
+ * copies of each tile (and therefore their random streams) are kept in the stepper data between steps.
+ **/
+template<typename StepperPerBin>
+class StepperBinsPerBinParallel {
+    StepperPerBin bin_stepper;
+    std::uint64_t seed;
+    std::size_t nthreads;
+    std::size_t tile_size;
+
+    template<typename StepperData, std::size_t DIMBINS>
+    struct Data {
+        vector_dimensions<StepperData,DIMBINS> bins;
+        std::vector<StepperPerBin> tile_steppers;
+        Data(const std::array<std::size_t,DIMBINS>& resolution) : bins(resolution) { }
+    };
+
+    template<std::size_t DIMBINS, typename F>
+    void for_each_bin(const std::array<std::size_t,DIMBINS>& resolution, const F& f) const {
+        std::size_t n = detail::bins_count(resolution);
+        parallel_for((n+tile_size-1)/tile_size, [&] (std::size_t tile, std::size_t thread) {
+            for (std::size_t i = tile*tile_size; i<std::min(n,(tile+1)*tile_size); ++i)
+                f(tile,detail::bin_position(i,resolution));
+        }, nthreads);
+    }
+
+public:
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using StepperData = decltype(bin_stepper.init(f,range));
+        Data<StepperData,DIMBINS> data(resolution);
+        std::size_t tiles = (detail::bins_count(resolution)+tile_size-1)/tile_size;
+        data.tile_steppers.reserve(tiles);
+        for (std::size_t t = 0; t<tiles; ++t) data.tile_steppers.push_back(reseeded(bin_stepper,stream_seed(seed,t)));
+        for_each_bin(resolution, [&] (std::size_t tile, const std::array<std::size_t,DIMBINS>& pos) {
+            data.bins[pos] = data.tile_steppers[tile].init(f,detail::bin_range(pos,resolution,range));
+        });
+        return data;
+    }
+
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename StepperData>
+    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Data<StepperData,DIMBINS>& data) const {
+        for_each_bin(resolution, [&] (std::size_t tile, const std::array<std::size_t,DIMBINS>& pos) {
+            data.tile_steppers[tile].step(f,detail::bin_range(pos,resolution,range),data.bins(pos));
+        });
+    }
+
+    template<typename Bins, typename F, typename Float, std::size_t DIM, std::size_t DIMBINS, typename StepperData>
+    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Data<StepperData,DIMBINS>& data) const {
+        for_each_bin(resolution, [&] (std::size_t tile, const std::array<std::size_t,DIMBINS>& pos) {
+            bins(pos) = data.bins.size()*data.tile_steppers[tile].integral(f,detail::bin_range(pos,resolution,range),data.bins(pos));
+        });
+    }
+
+    StepperBinsPerBinParallel(StepperPerBin&& bs, std::uint64_t seed, std::size_t nthreads, std::size_t tile_size) :
+        bin_stepper(std::forward<StepperPerBin>(bs)), seed(seed), nthreads(nthreads), tile_size(std::max(std::size_t(1),tile_size)) { }
+};
+
+template<typename StepperPerBin>
+auto stepper_bins_per_bin_parallel(StepperPerBin&& bin_stepper, std::uint64_t seed = std::random_device()(), std::size_t nthreads = default_threads(), std::size_t tile_size = 64) {
+    return StepperBinsPerBinParallel<std::decay_t<StepperPerBin>>(std::decay_t<StepperPerBin>(std::forward<StepperPerBin>(bin_stepper)),seed,nthreads,tile_size);
+}
+
+}
@@ -77,6 +77,25 @@ public:
         }
     }
 
+    //Checkpointing (see checkpoint.h), if the stepper of each bin supports it
+    template<typename Out, std::size_t DIMBINS, typename StepperData>
+    void checkpoint(Out& out, const vector_dimensions<StepperData,DIMBINS>& data) const {
+        for (auto pos : multidimensional_range(data.resolution())) bin_stepper.checkpoint(out,data[pos]);
+    }
+
+    template<typename In, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using StepperData = decltype(bin_stepper.init(f,range));
+        vector_dimensions<StepperData,DIMBINS> data(resolution);
+        for (auto pos : multidimensional_range(resolution)) data[pos] = bin_stepper.resume(in,f,range);
+        return data;
+    }
+
+    template<typename Out>
+    void save(Out& out) const { out.write_state(bin_stepper); }
+    template<typename In>
+    void load(In& in) { in.read_state(bin_stepper); }
+
     StepperBinsPerBin(StepperPerBin&& bs) : bin_stepper(std::forward<StepperPerBin>(bs)) { }
 };
 
@@ -85,23 +104,42 @@ auto stepper_bins_per_bin(StepperPerBin&& bin_stepper) {
     return StepperBinsPerBin<std::decay_t<StepperPerBin>>(std::forward<StepperPerBin>(bin_stepper));
 }
 
-template<typename Stepper, typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
-void integrate_bins_stepper_progression(const std::string& name, const Stepper& stepper, unsigned long iterations, Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) {
+/**
+ * Every preview_every iterations, the bins are updated with the current integral and preview(bins,iteration) is called,
+ * for instance to save a progressive image. The bins are reset to zero before each integral, so any stepper works
+ * (even those whose integral adds to the bins), but the integral should be cheap, as in stepper_bins_adaptive_incremental
+ * (the integral of stepper_bins_adaptive visits all regions).
+ **/
+template<typename Stepper, typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Preview>
+void integrate_bins_stepper_progression(const std::string& name, const Stepper& stepper, unsigned long iterations, Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range,
+        const Preview& preview, unsigned long preview_every) {
     std::cerr<<name<<" - \r";
 	auto start = std::chrono::steady_clock::now();
     auto data = stepper.init(resolution, f, range);
+    auto clear_bins = [&] () { for (auto pos : multidimensional_range(resolution)) bins(pos) = decltype(f(range.min()))(0); };
     for (unsigned long i = 0; i<iterations;++i) {
         stepper.step(resolution,f,range,data);
+        if ((preview_every > 0) && (((i+1)%preview_every) == 0) && ((i+1) < iterations)) {
+            clear_bins();
+            stepper.integral(bins,resolution,f,range,data);
+            preview(bins,i+1);
+        }
 	    auto end = std::chrono::steady_clock::now();
 		auto elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(end - start); 
         std::cerr<<name<<" - \t"<<std::fixed<<std::setprecision(2)<<std::setw(6)<<(100.0f*float(i)/float(iterations))<<"%\t("<<std::setprecision(3)<<std::setw(6)<<elapsed.count()<<" seconds)\r";
     }   
+    if ((preview_every > 0) && (iterations > preview_every)) clear_bins(); //Previews were written to the bins
     stepper.integral(bins,resolution,f,range,data);
     auto end = std::chrono::steady_clock::now();
 	auto elapsed = std::chrono::duration_cast<std::chrono::duration<double> >(end - start); 
     std::cout<<name<<" - \t[DONE] \t("<<std::setprecision(3)<<std::setw(6)<<elapsed.count()<<" seconds)"<<std::endl;
 }
 
+template<typename Stepper, typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+void integrate_bins_stepper_progression(const std::string& name, const Stepper& stepper, unsigned long iterations, Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) {
+    integrate_bins_stepper_progression(name,stepper,iterations,bins,resolution,f,range,[] (const Bins&, unsigned long) { },0);
+}
+
 }
 
 
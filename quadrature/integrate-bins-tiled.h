@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <type_traits>
+#include "integrate-bins.h"
+#include "vector-dimensions.h"
+#include "multidimensional-range.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace viltrum {
+
+/**
+ * Bins stored in a binary file instead of memory: the raw values of type T, with the first dimension changing faster
+ * (the same order as vector_dimensions), and nothing else. The file is written through a shared memory mapping (on
+ * platforms without mmap, through positioned writes), so memory is only used for the parts being written and the
+ * operating system flushes them to disk. It is the output of integrate_bins_tiled, which writes it a tile at a time.
+ **/
+template<typename T, std::size_t DIMBINS>
+class BinsFile {
+    static_assert(std::is_trivially_copyable_v<T>,"BinsFile needs values that can be copied as raw bytes");
+    std::array<std::size_t,DIMBINS> res;
+    std::size_t elements = 1;
+#if defined(_WIN32)
+    mutable std::fstream file;
+#else
+    T* data = nullptr;
+#endif
+
+    std::size_t position(const std::array<std::size_t,DIMBINS>& p) const {
+        std::size_t pos = 0, prod = 1;
+        for (std::size_t d = 0;d<DIMBINS; ++d) { pos += p[d]*prod; prod*=res[d]; }
+        return pos;
+    }
+
+public:
+    BinsFile(const std::string& filename, const std::array<std::size_t,DIMBINS>& resolution) : res(resolution) {
+        for (auto r : res) elements*=r;
+#if defined(_WIN32)
+        { std::ofstream create(filename, std::ios::binary | std::ios::trunc); }
+        file.open(filename, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file) throw std::runtime_error("Cannot open bins file "+filename);
+        if (elements>0) { file.seekp(std::streamoff(elements*sizeof(T) - 1)); file.put('\0'); }
+#else
+        int fd = ::open(filename.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+        if (fd<0) throw std::runtime_error("Cannot open bins file "+filename);
+        if (::ftruncate(fd,off_t(elements*sizeof(T)))!=0) { ::close(fd); throw std::runtime_error("Cannot resize bins file "+filename); }
+        if (elements>0) {
+            void* m = ::mmap(nullptr,elements*sizeof(T),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+            if (m==MAP_FAILED) { ::close(fd); throw std::runtime_error("Cannot map bins file "+filename); }
+            data = static_cast<T*>(m);
+        }
+        ::close(fd);
+#endif
+    }
+
+    BinsFile(const BinsFile&) = delete;
+    BinsFile& operator=(const BinsFile&) = delete;
+
+    ~BinsFile() {
+#if !defined(_WIN32)
+        if (data) { ::msync(data,elements*sizeof(T),MS_SYNC); ::munmap(data,elements*sizeof(T)); }
+#endif
+    }
+
+    const std::array<std::size_t,DIMBINS>& resolution() const { return res; }
+    std::size_t size() const { return elements; }
+
+    //Writes tile (scaled by factor) with its first bin at origin, one row (along the first dimension) at a time
+    template<typename Tile>
+    void write_tile(const std::array<std::size_t,DIMBINS>& origin, const Tile& tile, double factor = 1.0) {
+        const auto& tres = tile.resolution();
+        std::vector<T> row(tres[0]);
+        std::array<std::size_t,DIMBINS> rows = tres; rows[0] = 1;
+        for (auto r : multidimensional_range(rows)) {
+            std::array<std::size_t,DIMBINS> pos = r, global;
+            for (std::size_t i = 0; i<tres[0]; ++i) { pos[0] = i; row[i] = tile[pos]*factor; }
+            for (std::size_t d = 0; d<DIMBINS; ++d) global[d] = origin[d] + r[d];
+#if defined(_WIN32)
+            file.seekp(std::streamoff(position(global)*sizeof(T)));
+            file.write(reinterpret_cast<const char*>(row.data()),std::streamsize(row.size()*sizeof(T)));
+#else
+            std::copy(row.begin(),row.end(),data + position(global));
+#endif
+        }
+    }
+
+    T operator[](const std::array<std::size_t,DIMBINS>& p) const {
+#if defined(_WIN32)
+        T t; file.seekg(std::streamoff(position(p)*sizeof(T)));
+        file.read(reinterpret_cast<char*>(&t),sizeof(T));
+        return t;
+#else
+        return data[position(p)];
+#endif
+    }
+};
+
+namespace detail {
+template<typename Output, typename Tile, std::size_t DIMBINS, typename = void>
+struct has_write_tile : std::false_type {};
+template<typename Output, typename Tile, std::size_t DIMBINS>
+struct has_write_tile<Output,Tile,DIMBINS,std::void_t<decltype(std::declval<Output&>().write_tile(
+    std::declval<const std::array<std::size_t,DIMBINS>&>(),std::declval<const Tile&>(),1.0))>> : std::true_type {};
+}
+
+/**
+ * Integrates the bins in tiles of (at most) tile_size bins: each tile is integrated on its own by integrator, over
+ * the part of range that it covers, and then written to output. Only one tile is kept in memory, and the integrator
+ * only builds regions (or samples) for that tile, so memory depends on the tile size instead of the resolution.
+ * output can be a BinsFile (written a tile at a time) or any bins. Bins of different tiles are integrated
+ * independently, so adaptive integrators refine each tile separately (iterations are per tile).
+ **/
+template<typename IntegratorBins, typename Output, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+void integrate_bins_tiled(const IntegratorBins& integrator_bins, const std::array<std::size_t,DIMBINS>& tile_size, Output& output,
+        const std::array<std::size_t,DIMBINS>& resolution, const F& function, const Range<Float,DIM>& range) {
+    using value_type = decltype(function(range.min()));
+    std::array<std::size_t,DIMBINS> tiles;
+    std::array<Float,DIMBINS> drange;
+    double total = 1;
+    for (std::size_t i = 0; i<DIMBINS; ++i) {
+        if (tile_size[i]==0) throw std::invalid_argument("integrate_bins_tiled: empty tiles");
+        tiles[i] = (resolution[i] + tile_size[i] - 1)/tile_size[i];
+        drange[i] = (range.max(i) - range.min(i))/Float(resolution[i]);
+        total *= resolution[i];
+    }
+    for (auto t : multidimensional_range(tiles)) {
+        std::array<std::size_t,DIMBINS> origin, tile_resolution;
+        Range<Float,DIM> tile_range = range;
+        double bins_in_tile = 1;
+        for (std::size_t i = 0; i<DIMBINS; ++i) {
+            origin[i] = t[i]*tile_size[i];
+            tile_resolution[i] = std::min(tile_size[i],resolution[i] - origin[i]);
+            tile_range = tile_range.subrange_dimension(i,range.min(i) + Float(origin[i])*drange[i],
+                (origin[i] + tile_resolution[i] == resolution[i])?range.max(i):(range.min(i) + Float(origin[i] + tile_resolution[i])*drange[i]));
+            bins_in_tile *= tile_resolution[i];
+        }
+        vector_dimensions<value_type,DIMBINS> tile(tile_resolution);
+        integrator_bins.integrate(tile,tile_resolution,function,tile_range);
+        //Bins integrators scale the integral of each bin by the number of bins
+        double factor = total/bins_in_tile;
+        if constexpr (detail::has_write_tile<Output,vector_dimensions<value_type,DIMBINS>,DIMBINS>::value)
+            output.write_tile(origin,tile,factor);
+        else for (auto pos : multidimensional_range(tile_resolution)) {
+            std::array<std::size_t,DIMBINS> global;
+            for (std::size_t i = 0; i<DIMBINS; ++i) global[i] = origin[i] + pos[i];
+            output(global) = tile[pos]*factor;
+        }
+    }
+}
+
+}
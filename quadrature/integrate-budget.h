@@ -0,0 +1,225 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <cmath>
+#include <type_traits>
+#include "range.h"
+
+namespace viltrum {
+
+/**
+ * Limits for the budgeted integrators: they keep stepping until any of them is reached. Unset limits are unbounded,
+ * so at least one of them should be set (otherwise no step is taken). For instance
+ *
+ *     integrator_budget(stepper_adaptive(nested(simpson,trapezoidal)), budget().seconds(0.1).error(1.e-6))
+ *
+ * steps for 0.1 seconds or until the error estimation reaches 1.e-6, whatever comes first.
+ **/
+class Budget {
+    unsigned long max_iterations_ = std::numeric_limits<unsigned long>::max();
+    unsigned long max_evaluations_ = std::numeric_limits<unsigned long>::max();
+    double max_seconds_ = std::numeric_limits<double>::infinity();
+    double target_error_ = -1.0;
+public:
+    //Maximum number of steps
+    Budget& iterations(unsigned long n) { max_iterations_ = n; return (*this); }
+    //Maximum number of integrand evaluations. If steps have a constant cost, it is never exceeded.
+    Budget& evaluations(unsigned long n) { max_evaluations_ = n; return (*this); }
+    //Maximum wall-clock time, in seconds, including the initialization of the stepper
+    Budget& seconds(double s) { max_seconds_ = s; return (*this); }
+    //Stop when the error estimation of the stepper is at or below e (only for steppers that provide error_estimate)
+    Budget& error(double e) { target_error_ = e; return (*this); }
+
+    unsigned long max_iterations() const { return max_iterations_; }
+    unsigned long max_evaluations() const { return max_evaluations_; }
+    double max_seconds() const { return max_seconds_; }
+    double target_error() const { return target_error_; }
+    bool bounded() const {
+        return (max_iterations_ < std::numeric_limits<unsigned long>::max()) ||
+               (max_evaluations_ < std::numeric_limits<unsigned long>::max()) ||
+               std::isfinite(max_seconds_) || (target_error_ >= 0.0);
+    }
+};
+
+inline Budget budget() { return Budget(); }
+
+//Which limit stopped the integration
+enum class BudgetStop { iterations, evaluations, time, error };
+
+inline const char* to_string(BudgetStop s) {
+    switch (s) {
+        case BudgetStop::iterations:  return "iterations";
+        case BudgetStop::evaluations: return "evaluations";
+        case BudgetStop::time:        return "time";
+        case BudgetStop::error:       return "error";
+    }
+    return "";
+}
+
+struct BudgetReport {
+    BudgetStop stop = BudgetStop::iterations;
+    unsigned long iterations = 0;
+    unsigned long evaluations = 0;
+    double seconds = 0.0;
+    double error = std::numeric_limits<double>::quiet_NaN(); //NaN if the stepper has no error estimation
+};
+
+namespace detail {
+
+//Integrand that counts its evaluations (also through evaluate_batch), safe for steppers that evaluate in parallel
+template<typename F>
+class EvaluationCounter {
+    const F& f;
+    std::atomic<unsigned long>& counter;
+public:
+    EvaluationCounter(const F& f, std::atomic<unsigned long>& counter) : f(f), counter(counter) { }
+
+    template<typename Float, std::size_t DIM>
+    auto operator()(const std::array<Float,DIM>& x) const {
+        counter.fetch_add(1,std::memory_order_relaxed);
+        return f(x);
+    }
+
+    template<typename Float, std::size_t DIM, typename VT, typename G = F>
+    auto evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<VT>& values) const
+            -> decltype(std::declval<const G&>().evaluate_batch(points,values)) {
+        counter.fetch_add(points.size(),std::memory_order_relaxed);
+        return f.evaluate_batch(points,values);
+    }
+};
+
+template<typename S, typename F, typename R, typename D, typename = void>
+struct has_error_estimate : std::false_type {};
+
+template<typename S, typename F, typename R, typename D>
+struct has_error_estimate<S,F,R,D,std::void_t<decltype(std::declval<const S&>().error_estimate(
+        std::declval<const F&>(),std::declval<const R&>(),std::declval<const D&>()))>> : std::true_type {};
+
+template<typename S, typename RES, typename F, typename R, typename D, typename = void>
+struct has_bins_error_estimate : std::false_type {};
+
+template<typename S, typename RES, typename F, typename R, typename D>
+struct has_bins_error_estimate<S,RES,F,R,D,std::void_t<decltype(std::declval<const S&>().error_estimate(
+        std::declval<const RES&>(),std::declval<const F&>(),std::declval<const R&>(),std::declval<const D&>()))>> : std::true_type {};
+
+/**
+ * Runs step() until a limit of the budget is reached. error_estimate() returns the current error estimation (or NaN
+ * if unavailable).
+ **/
+template<typename Step, typename ErrorEstimate>
+BudgetReport run_budget(const Budget& budget, std::chrono::steady_clock::time_point start, const std::atomic<unsigned long>& evaluations,
+        const Step& step, const ErrorEstimate& error_estimate) {
+    BudgetReport report;
+    auto elapsed = [&] () { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+    unsigned long last_cost = 0;
+    while (true) {
+        report.error = error_estimate();
+        report.evaluations = evaluations.load(std::memory_order_relaxed);
+        report.seconds = elapsed();
+        if (!budget.bounded()) { report.stop = BudgetStop::iterations; break; }
+        if (report.error <= budget.target_error()) { report.stop = BudgetStop::error; break; }
+        if ((report.evaluations >= budget.max_evaluations()) ||
+            (last_cost > (budget.max_evaluations() - report.evaluations))) { report.stop = BudgetStop::evaluations; break; }
+        if (report.seconds >= budget.max_seconds()) { report.stop = BudgetStop::time; break; }
+        if (report.iterations >= budget.max_iterations()) { report.stop = BudgetStop::iterations; break; }
+        step();
+        ++report.iterations;
+        last_cost = evaluations.load(std::memory_order_relaxed) - report.evaluations;
+    }
+    return report;
+}
+
+}
+
+/**
+ * Runs a stepper until a time, evaluation or error budget is reached, instead of for a fixed number of iterations.
+ * The report of the last integration (which limit stopped it, and how many iterations, evaluations and seconds it
+ * took) is available through last_report(), or can be obtained directly through the report parameter of integrate.
+ **/
+template<typename Stepper>
+class IntegratorBudget {
+    Stepper stepper;
+    Budget limits;
+    mutable BudgetReport last;
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto integrate(const F& function, const Range<Float,DIM>& range, BudgetReport& report) const {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<unsigned long> evaluations(0);
+        detail::EvaluationCounter<F> f(function,evaluations);
+        auto data = stepper.init(f,range);
+        report = detail::run_budget(limits,start,evaluations,
+            [&] () { stepper.step(f,range,data); },
+            [&] () {
+                if constexpr (detail::has_error_estimate<Stepper,decltype(f),Range<Float,DIM>,decltype(data)>::value)
+                    return double(stepper.error_estimate(f,range,data));
+                else return std::numeric_limits<double>::quiet_NaN();
+            });
+        auto sol = stepper.integral(f,range,data);
+        last = report;
+        return sol;
+    }
+
+    template<typename F, typename Float, std::size_t DIM>
+    auto integrate(const F& f, const Range<Float,DIM>& range) const {
+        BudgetReport report;
+        return integrate(f,range,report);
+    }
+
+    const BudgetReport& last_report() const { return last; }
+
+    IntegratorBudget(Stepper&& s, const Budget& b) :
+        stepper(std::forward<Stepper>(s)), limits(b) { }
+};
+
+template<typename Stepper>
+auto integrator_budget(Stepper&& stepper, const Budget& budget) {
+    return IntegratorBudget<std::decay_t<Stepper>>(std::decay_t<Stepper>(std::forward<Stepper>(stepper)), budget);
+}
+
+template<typename Stepper>
+class IntegratorBinsBudget {
+    Stepper stepper;
+    Budget limits;
+    mutable BudgetReport last;
+public:
+	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution,
+		    const F& function, const Range<Float,DIM>& range, BudgetReport& report) const {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<unsigned long> evaluations(0);
+        detail::EvaluationCounter<F> f(function,evaluations);
+        auto data = stepper.init(bin_resolution,f,range);
+        report = detail::run_budget(limits,start,evaluations,
+            [&] () { stepper.step(bin_resolution,f,range,data); },
+            [&] () {
+                if constexpr (detail::has_bins_error_estimate<Stepper,std::array<std::size_t,DIMBINS>,decltype(f),Range<Float,DIM>,decltype(data)>::value)
+                    return double(stepper.error_estimate(bin_resolution,f,range,data));
+                else return std::numeric_limits<double>::quiet_NaN();
+            });
+        stepper.integral(bins,bin_resolution,f,range,data);
+        last = report;
+    }
+
+	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range) const {
+        BudgetReport report;
+        integrate(bins,bin_resolution,f,range,report);
+    }
+
+    const BudgetReport& last_report() const { return last; }
+
+    IntegratorBinsBudget(Stepper&& s, const Budget& b) :
+        stepper(std::forward<Stepper>(s)), limits(b) { }
+};
+
+template<typename Stepper>
+auto integrator_bins_budget(Stepper&& stepper, const Budget& budget) {
+    return IntegratorBinsBudget<std::decay_t<Stepper>>(std::decay_t<Stepper>(std::forward<Stepper>(stepper)), budget);
+}
+
+}
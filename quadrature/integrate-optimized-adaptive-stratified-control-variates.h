@@ -3,6 +3,12 @@
 #include <vector>
 #include "integrate.h"
 #include "multidimensional-range.h"
+#include "bin-index.h"
+#include "tensor-horner.h"
+#include "random.h"
+#include "quasi-monte-carlo.h"
+#include "../utils/parallel.h"
+#include "../utils/philox.h"
 #include <random>
 #include <vector>
 #include <array>
@@ -102,15 +108,37 @@ class FunctionSampler {
 public:
 	template<typename F, typename Float, std::size_t DIM, typename RNG>
 	auto sample(const F& f, const Range<Float,DIM>& range, RNG& rng) const {
-		std::array<Float,DIM> sample;
-	    for (std::size_t i=0;i<DIM;++i) {
-		    std::uniform_real_distribution<Float> dis(range.min(i),range.max(i));
-		    sample[i] = dis(rng);
-		}
+		std::array<Float,DIM> sample = sample_uniform(rng,range);
 		return std::make_tuple(f(sample),sample);
 	}
 };
 
+/**
+ * Takes n samples of f within range with sampler, calling g(value,sample) for each of them. Samplers can provide
+ * sample_batch(f,range,rng,n,g) to correlate the samples of a batch (see FunctionSamplerQuasiMonteCarlo), otherwise
+ * sample is called n times.
+ **/
+namespace detail {
+template<typename Sampler, typename F, typename Float, std::size_t DIM, typename RNG, typename G>
+auto sample_batch(const Sampler& sampler, const F& f, const Range<Float,DIM>& range, RNG& rng, std::size_t n, const G& g, int)
+		-> decltype(sampler.sample_batch(f,range,rng,n,g)) {
+	return sampler.sample_batch(f,range,rng,n,g);
+}
+
+template<typename Sampler, typename F, typename Float, std::size_t DIM, typename RNG, typename G>
+void sample_batch(const Sampler& sampler, const F& f, const Range<Float,DIM>& range, RNG& rng, std::size_t n, const G& g, long) {
+	for (std::size_t i = 0; i<n; ++i) {
+		auto [value,sample] = sampler.sample(f,range,rng);
+		g(value,sample);
+	}
+}
+}
+
+template<typename Sampler, typename F, typename Float, std::size_t DIM, typename RNG, typename G>
+void sample_batch(const Sampler& sampler, const F& f, const Range<Float,DIM>& range, RNG& rng, std::size_t n, const G& g) {
+	detail::sample_batch(sampler,f,range,rng,n,g,0);
+}
+
 template<typename Float, std::size_t DIM, std::size_t DIMBINS>
 Range<Float,DIMBINS> range_of_pixel(const std::array<std::size_t,DIMBINS>& pixel, const std::array<std::size_t,DIMBINS>& bin_resolution, const Range<Float,DIM>& range) {
 	std::array<Float, DIMBINS> submin, submax;
@@ -122,68 +150,131 @@ Range<Float,DIMBINS> range_of_pixel(const std::array<std::size_t,DIMBINS>& pixel
 }
 
 
-template<typename RegionGenerator, typename AlphaCalculator, typename Sampler, typename RNG>
-class IntegratorStratifiedAllControlVariates {
+namespace detail {
+/**
+ * What the serial and parallel versions of IntegratorStratifiedAllControlVariates share: the integral of a single
+ * pixel, with the spp samples of the pixel distributed among all the regions that overlap it.
+ **/
+template<typename RegionGenerator, typename AlphaCalculator, typename Sampler>
+class StratifiedAllControlVariates {
+protected:
 	RegionGenerator region_generator;
 	AlphaCalculator alpha_calculator;
 	Sampler sampler;
-	mutable RNG rng;
 	unsigned long spp;
+
+	//samples is just a buffer, so it can be reused from one pixel to the next
+	template<typename Regions, typename Approximations, typename RegionsPerPixel, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename RNG, typename value_type>
+	value_type pixel_integral(const Regions& regions, const Approximations& approximations, const RegionsPerPixel& regions_per_pixel,
+			const std::array<std::size_t,DIMBINS>& pixel, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range,
+			RNG& rng, std::vector<std::tuple<value_type,value_type>>& samples) const {
+		value_type result(0);
+		auto pixel_range = range_of_pixel(pixel,bin_resolution,range);
+		auto regions_here = regions_per_pixel[pixel];
+		std::size_t samples_per_region = spp / regions_here.size();
+		std::size_t samples_per_region_rest = spp % regions_here.size();
+		std::uniform_int_distribution<std::size_t> sr(std::size_t(0),regions_here.size()-1);
+		std::size_t sampled_region = sr(rng);
+		for (std::size_t r = 0; r<regions_here.size(); ++r) { // Per region inside the pixel
+			std::size_t nsamples = samples_per_region;
+			if (((r - sampled_region)%(regions_here.size()))<samples_per_region_rest) nsamples+=1;
+			auto local_range = pixel_range.intersection_large(regions[regions_here[r]].range());
+			if (nsamples == 0) 
+				result += double(regions_per_pixel.size())*regions[regions_here[r]].integral_subrange(local_range);
+			else {
+				samples.resize(nsamples);
+			    double factor = local_range.volume()*double(regions_per_pixel.size())*double(regions_here.size());
+			//  ^^ MC probability      ^^ Global size (res-constant)     ^^ Region probability
+	
+				std::size_t i = 0;
+				sample_batch(sampler,f,local_range,rng,nsamples,[&] (const auto& value, const auto& sample) {
+					samples[i++] = std::make_tuple(factor*value, factor*approximations(regions,regions_here[r],sample));
+				});
+				auto a = alpha_calculator.alpha(samples);
+				value_type residual = (std::get<0>(samples[0]) - a*std::get<1>(samples[0]));
+				for (std::size_t s=1; s<nsamples;++s)
+					residual += (std::get<0>(samples[s]) - a*std::get<1>(samples[s]));
+			
+				//We are multiplying all the samples by the number of regions so we do this
+				result += (residual/double(spp)); //... instead of this -> (residual/double(nsamples))
+				result += double(regions_per_pixel.size())*a*regions[regions_here[r]].integral_subrange(local_range);
+				//If we covered each region independently we would not multiply by the number of regions
+			}
+		}
+		return result;
+	}
+
+	StratifiedAllControlVariates(RegionGenerator&& region_generator,
+		AlphaCalculator&& alpha_calculator, Sampler&& sampler, unsigned long spp) :
+			region_generator(std::forward<RegionGenerator>(region_generator)),
+			alpha_calculator(std::forward<AlphaCalculator>(alpha_calculator)),
+			sampler(std::forward<Sampler>(sampler)), spp(spp) {}
+};
+}
+
+template<typename RegionGenerator, typename AlphaCalculator, typename Sampler, typename RNG>
+class IntegratorStratifiedAllControlVariates : detail::StratifiedAllControlVariates<RegionGenerator,AlphaCalculator,Sampler> {
+	using Base = detail::StratifiedAllControlVariates<RegionGenerator,AlphaCalculator,Sampler>;
+	mutable RNG rng;
 public:
 
 	typedef void is_integrator_tag;
 
 	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
 	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range) const {
-        auto regions = region_generator.compute_regions(f,range);
+        auto regions = this->region_generator.compute_regions(f,range);
+		auto approximations = approximation_cache(regions);
 		using value_type = decltype(f(range.min()));
-		using R = typename decltype(regions)::value_type;
-		vector_dimensions<std::vector<const R*>,DIMBINS> regions_per_pixel(bin_resolution);
-		for (const auto& r : regions) for (auto pixel : pixels_in_region(r,bin_resolution,range))
-			regions_per_pixel[pixel].push_back(&r);
-		for (auto pixel : multidimensional_range(bin_resolution)) { // Per pixel
-			bins(pixel) = value_type(0);
-			auto pixel_range = range_of_pixel(pixel,bin_resolution,range);
-			const auto& regions_here = regions_per_pixel[pixel];
-			std::size_t samples_per_region = spp / regions_here.size();
-            std::size_t samples_per_region_rest = spp % regions_here.size();
-			std::uniform_int_distribution<std::size_t> sr(std::size_t(0),regions_here.size()-1);
-			std::size_t sampled_region = sr(rng);
-			for (std::size_t r = 0; r<regions_here.size(); ++r) { // Per region inside the pixel
-                std::size_t nsamples = samples_per_region;
-				if (((r - sampled_region)%(regions_here.size()))<samples_per_region_rest) nsamples+=1;
-                auto local_range = pixel_range.intersection_large(regions_here[r]->range());
-				if (nsamples == 0) 
-					bins(pixel) += double(regions_per_pixel.size())*regions_here[r]->integral_subrange(local_range);
-				else {
-					std::vector<std::tuple<value_type,value_type>> samples(nsamples);
-				    double factor = local_range.volume()*double(regions_per_pixel.size())*double(regions_here.size());
-				//  ^^ MC probability      ^^ Global size (res-constant)     ^^ Region probability
-		
-					for (auto& s : samples) {
-						auto [value,sample] = sampler.sample(f,local_range,rng);
-						s = std::make_tuple(factor*value, factor*regions_here[r]->approximation_at(sample));
-					}
-					auto a = alpha_calculator.alpha(samples);
-					value_type residual = (std::get<0>(samples[0]) - a*std::get<1>(samples[0]));
-					for (std::size_t s=1; s<nsamples;++s)
-						residual += (std::get<0>(samples[s]) - a*std::get<1>(samples[s]));
-				
-					//We are multiplying all the samples by the number of regions so we do this
-					bins(pixel) += (residual/double(spp)); //... instead of this -> (residual/double(nsamples))
-					bins(pixel) += double(regions_per_pixel.size())*a*regions_here[r]->integral_subrange(local_range);
-					//If we covered each region independently we would not multiply by the number of regions
-				}
-			}
-		}
+		auto regions_per_pixel = bin_index(bin_resolution, regions.size(), [&] (std::size_t i) {
+			return pixels_in_region(regions[i],bin_resolution,range); });
+		std::vector<std::tuple<value_type,value_type>> samples;
+		for (auto pixel : multidimensional_range(bin_resolution)) // Per pixel
+			bins(pixel) = this->pixel_integral(regions,approximations,regions_per_pixel,pixel,bin_resolution,f,range,rng,samples);
 	}
 	
 	IntegratorStratifiedAllControlVariates(RegionGenerator&& region_generator,
 		AlphaCalculator&& alpha_calculator, Sampler&& sampler, RNG&& rng, unsigned long spp) :
-			region_generator(std::forward<RegionGenerator>(region_generator)),
-			alpha_calculator(std::forward<AlphaCalculator>(alpha_calculator)),
-			sampler(std::forward<Sampler>(sampler)),
-			rng(std::forward<RNG>(rng)), spp(spp) {}
+			Base(std::forward<RegionGenerator>(region_generator),std::forward<AlphaCalculator>(alpha_calculator),
+				std::forward<Sampler>(sampler),spp),
+			rng(std::forward<RNG>(rng)) {}
+};
+
+/**
+ * Same algorithm as IntegratorStratifiedAllControlVariates, but the pixels are processed in parallel. Each pixel
+ * draws its random numbers from its own counter-based (Philox) stream, keyed on the seed and the pixel index, so
+ * the result is the same regardless of the number of threads. The sample buffers are reused per thread.
+ **/
+template<typename RegionGenerator, typename AlphaCalculator, typename Sampler>
+class IntegratorStratifiedAllControlVariatesParallel : detail::StratifiedAllControlVariates<RegionGenerator,AlphaCalculator,Sampler> {
+	using Base = detail::StratifiedAllControlVariates<RegionGenerator,AlphaCalculator,Sampler>;
+	std::uint64_t seed;
+	std::size_t nthreads;
+public:
+
+	typedef void is_integrator_tag;
+
+	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range) const {
+        auto regions = this->region_generator.compute_regions(f,range);
+		auto approximations = approximation_cache(regions);
+		using value_type = decltype(f(range.min()));
+		auto regions_per_pixel = bin_index(bin_resolution, regions.size(), [&] (std::size_t i) {
+			return pixels_in_region(regions[i],bin_resolution,range); }, nthreads);
+
+		std::vector<std::vector<std::tuple<value_type,value_type>>> buffers(nthreads);
+		parallel_for(regions_per_pixel.size(), [&] (std::size_t p, std::size_t thread) { // Per pixel
+			std::array<std::size_t,DIMBINS> pixel;
+			for (std::size_t d = 0, i = p; d<DIMBINS; ++d) { pixel[d] = i%bin_resolution[d]; i/=bin_resolution[d]; }
+			Philox rng(seed,p);
+			bins(pixel) = this->pixel_integral(regions,approximations,regions_per_pixel,pixel,bin_resolution,f,range,rng,buffers[thread]);
+		}, nthreads);
+	}
+	
+	IntegratorStratifiedAllControlVariatesParallel(RegionGenerator&& region_generator,
+		AlphaCalculator&& alpha_calculator, Sampler&& sampler, std::uint64_t seed, unsigned long spp, std::size_t nthreads) :
+			Base(std::forward<RegionGenerator>(region_generator),std::forward<AlphaCalculator>(alpha_calculator),
+				std::forward<Sampler>(sampler),spp),
+			seed(seed), nthreads(std::max(std::size_t(1),nthreads)) {}
 };
 
 template<typename RegionGenerator, typename AlphaCalculator, typename Sampler, typename RNG>
@@ -200,36 +291,34 @@ public:
 	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
 	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range) const {
         auto regions = region_generator.compute_regions(f,range);
+		auto approximations = approximation_cache(regions);
 		using value_type = decltype(f(range.min()));
-		using R = typename decltype(regions)::value_type;
-		vector_dimensions<std::vector<const R*>,DIMBINS> regions_per_pixel(bin_resolution);
-		for (const auto& r : regions) for (auto pixel : pixels_in_region(r,bin_resolution,range))
-			regions_per_pixel[pixel].push_back(&r);
+		auto regions_per_pixel = bin_index(bin_resolution, regions.size(), [&] (std::size_t i) {
+			return pixels_in_region(regions[i],bin_resolution,range); });
 		for (auto pixel : multidimensional_range(bin_resolution)) { // Per pixel
 			bins(pixel) = value_type(0);
 			auto pixel_range = range_of_pixel(pixel,bin_resolution,range);
-			const auto& regions_here = regions_per_pixel[pixel];
+			auto regions_here = regions_per_pixel[pixel];
 			std::size_t samples_per_region = spp / regions_here.size();
             std::size_t samples_per_region_rest = spp % regions_here.size();
 			std::vector<std::tuple<value_type,value_type>> samples; samples.reserve(spp);
 			
             //First: stratified distribution of samples (uniformly)
 			for (std::size_t r = 0; r<regions_here.size(); ++r) { 
-                auto local_range = pixel_range.intersection_large(regions_here[r]->range());
+                auto local_range = pixel_range.intersection_large(regions[regions_here[r]].range());
 				double factor = local_range.volume()*double(regions_per_pixel.size())*double(regions_here.size());
-				for (std::size_t s = 0; s<samples_per_region; ++s) {
-					auto [value,sample] = sampler.sample(f,local_range,rng);
-					samples.push_back(std::make_tuple(factor*value, factor*regions_here[r]->approximation_at(sample)));
-				}
+				sample_batch(sampler,f,local_range,rng,samples_per_region,[&] (const auto& value, const auto& sample) {
+					samples.push_back(std::make_tuple(factor*value, factor*approximations(regions,regions_here[r],sample)));
+				});
 			} 
             std::uniform_int_distribution<std::size_t> sample_region(std::size_t(0),regions_here.size()-1);
             //We randomly distribute the rest of samples among all regions 
             for (std::size_t i = 0; i<samples_per_region_rest; ++i) {
 			    std::size_t r = sample_region(rng);
-                auto local_range = pixel_range.intersection_large(regions_here[r]->range());
+                auto local_range = pixel_range.intersection_large(regions[regions_here[r]].range());
 				double factor = local_range.volume()*double(regions_per_pixel.size())*double(regions_here.size());
 				auto [value,sample] = sampler.sample(f,local_range,rng);
-				samples.push_back(std::make_tuple(factor*value, factor*regions_here[r]->approximation_at(sample)));
+				samples.push_back(std::make_tuple(factor*value, factor*approximations(regions,regions_here[r],sample)));
             }
 
 
@@ -238,7 +327,7 @@ public:
 			for (std::size_t s=1; s<spp;++s)
 				residual += (std::get<0>(samples[s]) - a*std::get<1>(samples[s]));
 			bins(pixel) += (residual/double(spp));
-			for (auto r : regions_here) bins(pixel) += double(regions_per_pixel.size())*a*r->integral_subrange(pixel_range.intersection_large(r->range()));
+			for (auto r : regions_here) bins(pixel) += double(regions_per_pixel.size())*a*regions[r].integral_subrange(pixel_range.intersection_large(regions[r].range()));
 		}
 	}
 	
@@ -264,6 +353,7 @@ public:
 	template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
 	void integrate(Bins& bins, const std::array<std::size_t,DIMBINS>& bin_resolution, const F& f, const Range<Float,DIM>& range) const {
         auto regions = region_generator.compute_regions(f,range);
+		auto approximations = approximation_cache(regions);
 		using value_type = decltype(f(range.min()));
 		
 		auto all_pixels = multidimensional_range(bin_resolution);
@@ -279,6 +369,7 @@ public:
 		
 		std::size_t ri=0;
 		for (const auto& r : regions) {
+			const std::size_t index = ri;
 			std::size_t nsamples = samples_per_region + 
 				(( (((ri++) + sampled_region) % regions.size()) < samples_per_region_rest )?1:0);
 			auto pixels = pixels_in_region(r,bin_resolution,range);
@@ -294,17 +385,16 @@ public:
 			for (auto pixel : pixels) {
 				auto pixel_range = range_of_pixel(pixel,bin_resolution,range).intersection_large(r.range());
 			    double factor = pixel_range.volume()*double(all_pixels)*double(pixels);
-				for (std::size_t pass = 0; pass < samples_per_pixel; ++pass) {
-					auto [value,sample] = sampler.sample(f,pixel_range,rng);
-					samples.push_back(std::make_tuple(factor*value, factor*r.approximation_at(sample)));
+				sample_batch(sampler,f,pixel_range,rng,samples_per_pixel,[&] (const auto& value, const auto& sample) {
+					samples.push_back(std::make_tuple(factor*value, factor*approximations(regions,index,sample)));
 					positions.push_back(pixel);
-				}
+				});
 			}
 			
 			double factor = r.range().volume()*double(all_pixels);
 			for (std::size_t i = 0; i < samples_per_pixel_rest; ++i) {
 				auto [value,sample] = sampler.sample(f,r.range(),rng);
-				samples.push_back(std::make_tuple(factor*value, factor*r.approximation_at(sample)));
+				samples.push_back(std::make_tuple(factor*value, factor*approximations(regions,index,sample)));
 				std::array<std::size_t,DIMBINS> pixel;
 				for (std::size_t i=0;i<DIMBINS;++i) 
 					pixel[i] = std::size_t(bin_resolution[i]*(sample[i] - range.min(i))/(range.max(i) - range.min(i)));
@@ -338,22 +428,33 @@ auto integrator_stratified_all_control_variates(RegionGenerator&& rg,
 		AlphaCalculator&& alpha_calculator, Sampler&& sampler, RNG&& rng, unsigned long spp) {
 	return IntegratorStratifiedAllControlVariates<
 		std::decay_t<RegionGenerator>,std::decay_t<AlphaCalculator>,std::decay_t<Sampler>,std::decay_t<RNG>>(
-			std::forward<RegionGenerator>(rg),
-			std::forward<AlphaCalculator>(alpha_calculator),
-			std::forward<Sampler>(sampler),
-			std::forward<RNG>(rng),
+			std::decay_t<RegionGenerator>(std::forward<RegionGenerator>(rg)),
+			std::decay_t<AlphaCalculator>(std::forward<AlphaCalculator>(alpha_calculator)),
+			std::decay_t<Sampler>(std::forward<Sampler>(sampler)),
+			std::decay_t<RNG>(std::forward<RNG>(rng)),
 			spp);
 }
 
+template<typename RegionGenerator, typename AlphaCalculator, typename Sampler>
+auto integrator_stratified_all_control_variates_parallel(RegionGenerator&& rg,
+		AlphaCalculator&& alpha_calculator, Sampler&& sampler, std::uint64_t seed, unsigned long spp, std::size_t nthreads = default_threads()) {
+	return IntegratorStratifiedAllControlVariatesParallel<
+		std::decay_t<RegionGenerator>,std::decay_t<AlphaCalculator>,std::decay_t<Sampler>>(
+			std::decay_t<RegionGenerator>(std::forward<RegionGenerator>(rg)),
+			std::decay_t<AlphaCalculator>(std::forward<AlphaCalculator>(alpha_calculator)),
+			std::decay_t<Sampler>(std::forward<Sampler>(sampler)),
+			seed, spp, nthreads);
+}
+
 template<typename RegionGenerator, typename AlphaCalculator, typename Sampler, typename RNG>
 auto integrator_stratified_pixel_control_variates(RegionGenerator&& rg,
 		AlphaCalculator&& alpha_calculator, Sampler&& sampler, RNG&& rng, unsigned long spp) {
 	return IntegratorStratifiedPixelControlVariates<
 		std::decay_t<RegionGenerator>,std::decay_t<AlphaCalculator>,std::decay_t<Sampler>,std::decay_t<RNG>>(
-			std::forward<RegionGenerator>(rg),
-			std::forward<AlphaCalculator>(alpha_calculator),
-			std::forward<Sampler>(sampler),
-			std::forward<RNG>(rng),
+			std::decay_t<RegionGenerator>(std::forward<RegionGenerator>(rg)),
+			std::decay_t<AlphaCalculator>(std::forward<AlphaCalculator>(alpha_calculator)),
+			std::decay_t<Sampler>(std::forward<Sampler>(sampler)),
+			std::decay_t<RNG>(std::forward<RNG>(rng)),
 			spp);
 }
 
@@ -362,10 +463,10 @@ auto integrator_stratified_region_control_variates(RegionGenerator&& rg,
 		AlphaCalculator&& alpha_calculator, Sampler&& sampler, RNG&& rng, unsigned long spp) {
 	return IntegratorStratifiedRegionControlVariates<
 		std::decay_t<RegionGenerator>,std::decay_t<AlphaCalculator>,std::decay_t<Sampler>,std::decay_t<RNG>>(
-			std::forward<RegionGenerator>(rg),
-			std::forward<AlphaCalculator>(alpha_calculator),
-			std::forward<Sampler>(sampler),
-			std::forward<RNG>(rng),
+			std::decay_t<RegionGenerator>(std::forward<RegionGenerator>(rg)),
+			std::decay_t<AlphaCalculator>(std::forward<AlphaCalculator>(alpha_calculator)),
+			std::decay_t<Sampler>(std::forward<Sampler>(sampler)),
+			std::decay_t<RNG>(std::forward<RNG>(rng)),
 			spp);
 }
 
@@ -378,6 +479,14 @@ auto integrator_optimized_adaptive_stratified_control_variates(Nested&& nested,
 	return integrator_stratified_all_control_variates(region_generator(std::forward<Nested>(nested), std::forward<Error>(error), adaptive_iterations), AlphaOptimized(), FunctionSampler(), std::forward<RNG>(rng), spp);
 }
 
+//Parallel version: the results are the same for any number of threads
+template<typename Nested, typename Error>
+auto integrator_optimized_adaptive_stratified_control_variates_parallel(Nested&& nested, Error&& error, 
+		unsigned long adaptive_iterations, unsigned long spp, std::uint64_t seed = std::random_device()(), std::size_t nthreads = default_threads()) {
+			
+	return integrator_stratified_all_control_variates_parallel(region_generator(std::forward<Nested>(nested), std::forward<Error>(error), adaptive_iterations), AlphaOptimized(), FunctionSampler(), seed, spp, nthreads);
+}
+
 template<typename Nested, typename Error, typename RNG>
 auto integrator_optimized_perpixel_adaptive_stratified_control_variates(Nested&& nested, Error&& error, 
 		unsigned long adaptive_iterations, unsigned long spp, RNG&& rng,
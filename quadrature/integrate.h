@@ -12,8 +12,13 @@
 #include "rules.h"
 #include "nested.h"
 #include "range.h"
+#include "reseed.h"
+#include "adaptive-heap.h"
+#include "../utils/parallel.h"
 #include <cmath>
+#include <cassert>
 #include <algorithm>
+#include <vector>
 
 namespace viltrum {
 
@@ -92,6 +97,8 @@ public:
         return stepper.integral(f,range,data);
     }
 
+    void reseed(std::uint64_t seed) { reseed_random(stepper,seed); }
+
     IntegratorStepper(Stepper&& s, unsigned long i) :
         stepper(std::forward<Stepper>(s)), iterations(i) { }
     IntegratorStepper(const Stepper& s, unsigned long i) :
@@ -114,16 +121,129 @@ class StepperAdaptive {
 	    return std::get<0>(a.extra()) < std::get<0>(b.extra());
     }
 
+    //A region of a warm start together with the boxes of the partition inside it, [begin,end) in the boxes
+    template<typename R>
+    struct ReplayNode {
+        R region;
+        std::size_t begin, end;
+    };
+
+    /**
+     * Halves node along any dimension where no box crosses its middle, moving the boxes of the lower half before
+     * the others, and appends both halves to children. Returns false (and leaves node as it is) if node holds a
+     * single box, has no such dimension or its error is at or below coarsen_error.
+     **/
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    bool replay_split(const F& f, ReplayNode<R>& node, std::vector<Range<Float,DIM>>& boxes, double coarsen_error,
+            std::vector<ReplayNode<R>>& children) const {
+        if (((node.end - node.begin)<=1) || ((coarsen_error>0.0) && (double(std::get<0>(node.region.extra()))<=coarsen_error))) return false;
+        const auto& r = node.region.range();
+        auto first = boxes.begin() + node.begin, last = boxes.begin() + node.end;
+        for (std::size_t d = 0; d<DIM; ++d) {
+            Float mid = (r.min(d) + r.max(d))/Float(2);
+            Float tolerance = (r.max(d) - r.min(d))*Float(1.e-6);
+            auto is_low = [&] (const Range<Float,DIM>& b) { return b.max(d) <= (mid + tolerance); };
+            std::size_t nlow = 0; bool crosses = false;
+            for (auto b = first; (b!=last) && !crosses; ++b) {
+                if (is_low(*b)) ++nlow;
+                else crosses = (b->min(d) < (mid - tolerance));
+            }
+            if (crosses || (nlow==0) || (nlow==(node.end - node.begin))) continue;
+            std::partition(first,last,is_low);
+            auto halves = node.region.split(f,d);
+            assert(halves.size()==2);
+            std::size_t middle = node.begin + nlow;
+            for (std::size_t h = 0; h<2; ++h) {
+                auto errdim = error(halves[h]);
+                children.push_back(ReplayNode<R>{R(std::move(halves[h]),std::move(errdim)),(h==0)?node.begin:middle,(h==0)?middle:node.end});
+            }
+            return true;
+        }
+        return false;
+    }
+
 public:
     template<typename F, typename Float, std::size_t DIM>
     auto init(const F& f, const Range<Float,DIM>& range) const {
         auto r = region(f,nested,range.min(),range.max());
         auto errdim = error(r);
-        std::vector<ExtendedRegion<decltype(r),decltype(errdim)> > heap;
-        heap.emplace_back(r,errdim);
+        AdaptiveHeap<ExtendedRegion<decltype(r),decltype(errdim)> > heap;
+        heap.push(ExtendedRegion<decltype(r),decltype(errdim)>(r,errdim));
+        return heap;
+    }
+
+    /**
+     * Warm start: instead of starting from a single region, the splits that produced partition (typically
+     * region_partition() of the regions of an earlier integration over the same range, with a similar integrand)
+     * are replayed with f. As in step(), each split reuses the samples of the region it splits, so it takes exactly
+     * the same evaluations as the steps that built partition, but there is no heap search. The first splits (those
+     * of the regions with most boxes) are done serially until there are enough independent subtrees, which are then
+     * replayed depth-first by nthreads threads (f must be thread-safe if nthreads>1), with the same result for any
+     * number of threads. If coarsen_error is positive, regions whose error is at or below it are not split any
+     * further, which undoes (and saves the evaluations of) refinement that f does not need anymore. Boxes of
+     * partition that do not come from halving are replaced by the smallest region that contains them.
+     **/
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range, const std::vector<Range<Float,DIM>>& partition,
+            double coarsen_error = 0.0, std::size_t nthreads = 1) const {
+        using Heap = decltype(init(f,range));
+        using R = typename Heap::value_type;
+        constexpr std::size_t subtrees = 64;
+
+        std::vector<Range<Float,DIM>> boxes(partition);
+        std::vector<ReplayNode<R>> frontier, children;
+        auto r = region(f,nested,range.min(),range.max());
+        auto errdim = error(r);
+        frontier.push_back(ReplayNode<R>{R(std::move(r),std::move(errdim)),0,boxes.size()});
+        while (frontier.size() < subtrees) {
+            auto largest = std::max_element(frontier.begin(),frontier.end(),[] (const ReplayNode<R>& a, const ReplayNode<R>& b) {
+                return (a.end - a.begin) < (b.end - b.begin); });
+            children.clear();
+            if (!replay_split(f,*largest,boxes,coarsen_error,children)) break;
+            *largest = std::move(children[0]);
+            frontier.insert(largest+1,std::move(children[1]));
+        }
+
+        std::vector<std::vector<R>> leaves(frontier.size());
+        parallel_for(frontier.size(), [&] (std::size_t i, std::size_t) {
+            std::vector<ReplayNode<R>> stack;
+            stack.push_back(std::move(frontier[i]));
+            while (!stack.empty()) {
+                ReplayNode<R> node = std::move(stack.back()); stack.pop_back();
+                if (!replay_split(f,node,boxes,coarsen_error,stack)) leaves[i].push_back(std::move(node.region));
+            }
+        }, nthreads);
+
+        Heap heap;
+        for (auto& subtree : leaves) for (R& leaf : subtree) heap.push(std::move(leaf));
         return heap;
     }
 
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    void step(const F& f, const Range<Float,DIM>& range, AdaptiveHeap<R>& heap) const {
+        R r = heap.pop();
+        auto subregions = r.split(f,std::get<1>(r.extra()));
+        for (auto sr : subregions) {
+            auto errdim = error(sr);
+            heap.push(R(std::move(sr),std::move(errdim)));
+        }
+    }
+
+    //Same as above, also calling on_split(region,subregions) before the subregions replace the region in the heap
+    template<typename F, typename Float, std::size_t DIM, typename R, typename OnSplit>
+    void step(const F& f, const Range<Float,DIM>& range, AdaptiveHeap<R>& heap, const OnSplit& on_split) const {
+        R r = heap.pop();
+        std::vector<R> subregions;
+        for (auto sr : r.split(f,std::get<1>(r.extra()))) {
+            auto errdim = error(sr);
+            subregions.emplace_back(std::move(sr),std::move(errdim));
+        }
+        on_split(r,subregions);
+        for (R& sr : subregions) heap.push(std::move(sr));
+    }
+
+    //Plain vectors of regions (without running totals) are also accepted
+
     template<typename F, typename Float, std::size_t DIM, typename R>
     void step(const F& f, const Range<Float,DIM>& range, std::vector<R>& heap) const {
     	auto r = heap.front();
@@ -144,10 +264,54 @@ public:
         return sol;
     }
 
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto integral(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.integral();
+    }
+
+    //Sum of the error estimations of all the regions
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto error_estimate(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.error();
+    }
+
+    //Checkpointing (see checkpoint.h)
+    template<typename Out, typename R>
+    void checkpoint(Out& out, const AdaptiveHeap<R>& heap) const { heap.save(out); }
+
+    //Plain vectors of regions are saved in the same format (and resumed as an AdaptiveHeap)
+    template<typename Out, typename R>
+    void checkpoint(Out& out, const std::vector<R>& regions) const {
+        CompensatedSum<typename AdaptiveHeap<R>::integral_type> integral_total;
+        CompensatedSum<typename AdaptiveHeap<R>::error_type> error_total;
+        out.write(std::uint64_t(regions.size()));
+        for (const R& r : regions) {
+            r.save(out);
+            integral_total += r.integral(); error_total += std::get<0>(r.extra());
+        }
+        out.write(integral_total); out.write(error_total);
+    }
+
+    template<typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const F& f, const Range<Float,DIM>& range) const {
+        decltype(init(f,range)) heap;
+        heap.load(in,nested);
+        return heap;
+    }
+
     StepperAdaptive(N&& n, Error&& e) :
         nested(std::forward<N>(n)), error(std::forward<Error>(e)) { }
 };
 
+//Ranges of a container of regions (a partition of the integration range), for warm starting a later integration
+template<typename Regions>
+auto region_partition(const Regions& regions) {
+    std::vector<std::decay_t<decltype(regions.begin()->range())>> partition;
+    partition.reserve(regions.size());
+    for (const auto& r : regions) partition.push_back(r.range());
+    return partition;
+}
+
 template<typename N, typename Error>
 auto stepper_adaptive(N&& nested, Error&& error) {
     return StepperAdaptive<N,Error>(std::forward<N>(nested),std::forward<Error>(error));
@@ -158,6 +322,75 @@ auto stepper_adaptive(N&& nested) {
     return stepper_adaptive(std::forward<N>(nested), error_single_dimension_standard());
 }
 
+/**
+ * StepperAdaptive for plain integrals with bounded memory. Subregions whose error is below threshold are retired
+ * (see AdaptiveHeap::retire) instead of entering the heap: their integral and error are accumulated but their samples
+ * are freed, as they would only be split after every other region converged. If max_regions is not zero, whenever
+ * the heap grows beyond it, the regions with the lowest error are retired until 3/4 of max_regions are left (which
+ * costs O(1) amortized per step). integral() and error_estimate() include the retired regions, and once all regions
+ * are retired, step() does nothing. The regions left do not cover the range, so this is not for control variates or
+ * bins.
+ **/
+template<typename N, typename Error>
+class StepperAdaptiveRetire {
+    StepperAdaptive<N,Error> adaptive;
+    Error error;
+    double threshold;
+    std::size_t max_regions;
+
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range) const {
+        return adaptive.init(f,range);
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    void step(const F& f, const Range<Float,DIM>& range, AdaptiveHeap<R>& heap) const {
+        if (heap.empty()) return;
+        R r = heap.pop();
+        for (auto sr : r.split(f,std::get<1>(r.extra()))) {
+            auto errdim = error(sr);
+            R extended(std::move(sr),std::move(errdim));
+            if (double(std::get<0>(extended.extra())) < threshold) heap.retire(std::move(extended));
+            else heap.push(std::move(extended));
+        }
+        if ((max_regions > 0) && (heap.size() > max_regions)) heap.retire_lowest(std::max(std::size_t(1),(3*max_regions)/4));
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto integral(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.integral();
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename R>
+    auto error_estimate(const F& f, const Range<Float,DIM>& range, const AdaptiveHeap<R>& heap) const {
+        return heap.error();
+    }
+
+    //Checkpointing (see checkpoint.h): the totals keep the retired regions
+    template<typename Out, typename R>
+    void checkpoint(Out& out, const AdaptiveHeap<R>& heap) const { adaptive.checkpoint(out,heap); }
+
+    template<typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const F& f, const Range<Float,DIM>& range) const {
+        return adaptive.resume(in,f,range);
+    }
+
+    StepperAdaptiveRetire(N&& n, Error&& e, double threshold, std::size_t max_regions) :
+        adaptive(N(n), Error(e)), error(std::forward<Error>(e)), threshold(threshold), max_regions(max_regions) { }
+};
+
+template<typename N, typename Error, typename = std::enable_if_t<!std::is_arithmetic_v<std::decay_t<Error>>>>
+auto stepper_adaptive_retire(N&& nested, Error&& error, double threshold, std::size_t max_regions = 0) {
+    return StepperAdaptiveRetire<std::decay_t<N>,std::decay_t<Error>>(std::decay_t<N>(std::forward<N>(nested)),
+        std::decay_t<Error>(std::forward<Error>(error)), threshold, max_regions);
+}
+
+template<typename N>
+auto stepper_adaptive_retire(N&& nested, double threshold, std::size_t max_regions = 0) {
+    return stepper_adaptive_retire(std::forward<N>(nested), error_single_dimension_standard(), threshold, max_regions);
+}
+
 template<typename N, typename Error>
 auto integrator_adaptive_iterations(N&& nested, Error&& error, unsigned long iterations) {
     return integrator_stepper(stepper_adaptive(nested,error),iterations);
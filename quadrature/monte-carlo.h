@@ -3,6 +3,7 @@
 #include <array>
 #include <random>
 #include "range.h"
+#include "random.h"
 #include "integrate.h"
 #include "integrate-bins-stepper.h"
 #include "vector-dimensions.h"
@@ -35,11 +36,7 @@ public:
 
     template<typename F, typename Float, std::size_t DIM, typename Result>
     void step(const F& f, const Range<Float,DIM>& range, Samples<Result>& samples) const {
-    	std::array<Float,DIM> sample;
-	    for (std::size_t i=0;i<DIM;++i) {
-		    std::uniform_real_distribution<Float> dis(range.min(i),range.max(i));
-		    sample[i] = dis(rng);
-	    }
+    	std::array<Float,DIM> sample = sample_uniform(rng,range);
         samples.sumatory += range.volume()*f(sample);
         ++samples.counter;
     }
@@ -49,6 +46,28 @@ public:
         return (samples.counter==0)?decltype(samples.sumatory)(0):(samples.sumatory/double(samples.counter));
     }
 
+    //Checkpointing (see checkpoint.h): the generator is saved as the state of the stepper
+    template<typename Out, typename Result>
+    void checkpoint(Out& out, const Samples<Result>& samples) const {
+        out.write(samples.sumatory); out.write(samples.counter);
+    }
+
+    template<typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const F& f, const Range<Float,DIM>& range) const {
+        Samples<decltype(f(range.min()))> samples;
+        in.read(samples.sumatory); in.read(samples.counter);
+        return samples;
+    }
+
+    template<typename Out>
+    void save(Out& out) const { out.write(rng); }
+    template<typename In>
+    void load(In& in) { in.read(rng); }
+
+    //Not available when the generator is a reference, as copies of the stepper share it
+    template<typename R = RNG, typename = std::enable_if_t<!std::is_reference_v<R>>>
+    void reseed(std::uint64_t seed) { rng.seed(seed); }
+
     StepperMonteCarloUniform(RNG&& r) :
         rng(std::forward<RNG>(r)) { }
 };
@@ -74,11 +93,7 @@ public:
     //This stepper saves the global range so we can step with a local smaller range and it will still work
     template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Result>
     void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Samples<Result,DIMBINS,Float,DIM>& samples) const {
-    	std::array<Float,DIM> sample;
-	    for (std::size_t i=0;i<DIM;++i) {
-		    std::uniform_real_distribution<Float> dis(range.min(i),range.max(i));
-		    sample[i] = dis(rng);
-	    }
+    	std::array<Float,DIM> sample = sample_uniform(rng,range);
         if (samples.range.is_inside(sample)) {
             std::array<std::size_t,DIMBINS> pos;
             for (std::size_t i=0;i<DIMBINS;++i) {
@@ -100,9 +115,143 @@ public:
         }
     }
 
+    //Checkpointing (see checkpoint.h): the generator is saved as the state of the stepper
+    template<typename Out, typename Result, std::size_t DIMBINS, typename Float, std::size_t DIM>
+    void checkpoint(Out& out, const Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        out.write(samples.summatory.raw_data()); out.write(samples.range); out.write(samples.counter);
+    }
+
+    template<typename In, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using Result = decltype(f(range.min()));
+        std::vector<Result> summatory; in.read(summatory);
+        Samples<Result,DIMBINS,Float,DIM> samples(resolution, in.template read<Range<Float,DIM>>());
+        samples.summatory = vector_dimensions<Result,DIMBINS>(resolution,summatory);
+        in.read(samples.counter);
+        return samples;
+    }
+
+    template<typename Out>
+    void save(Out& out) const { out.write(rng); }
+    template<typename In>
+    void load(In& in) { in.read(rng); }
+
+    //Not available when the generator is a reference, as copies of the stepper share it
+    template<typename R = RNG, typename = std::enable_if_t<!std::is_reference_v<R>>>
+    void reseed(std::uint64_t seed) { rng.seed(seed); }
+
     StepperBinsMonteCarloUniform(RNG&& r) : rng(std::forward<RNG>(r)) { }
 };
 
+/**
+ * Uniform Monte Carlo with a counter-based random source: the i-th sample of a range is a pure function of the
+ * seed, the range and i, and the sample index lives in the stepper data. The stepper itself has no mutable state,
+ * so it can be shared among threads, and the samples are generated a whole point at a time.
+ **/
+class StepperMonteCarloCounter {
+    CounterRandom random;
+
+    template<typename Result>
+    struct Samples {
+        Result sumatory;
+        unsigned long counter;
+        std::uint64_t stream;
+        Samples(std::uint64_t stream) : sumatory(0),counter(0),stream(stream) { }
+    };
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range) const {
+        return Samples<decltype(f(range.min()))>(CounterRandom::stream_of(range));
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename Result>
+    void step(const F& f, const Range<Float,DIM>& range, Samples<Result>& samples) const {
+        samples.sumatory += range.volume()*f(random.uniform(range,samples.stream,samples.counter));
+        ++samples.counter;
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename Result>
+    Result integral(const F& f, const Range<Float,DIM>& range, const Samples<Result>& samples) const {
+        return (samples.counter==0)?decltype(samples.sumatory)(0):(samples.sumatory/double(samples.counter));
+    }
+
+    //Checkpointing (see checkpoint.h). The seed is not saved: resuming with another seed is still correct.
+    template<typename Out, typename Result>
+    void checkpoint(Out& out, const Samples<Result>& samples) const {
+        out.write(samples.sumatory); out.write(samples.counter); out.write(samples.stream);
+    }
+
+    template<typename In, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const F& f, const Range<Float,DIM>& range) const {
+        Samples<decltype(f(range.min()))> samples(0);
+        in.read(samples.sumatory); in.read(samples.counter); in.read(samples.stream);
+        return samples;
+    }
+
+    void reseed(std::uint64_t seed) { random.reseed(seed); }
+
+    StepperMonteCarloCounter(std::uint64_t seed) : random(seed) { }
+};
+
+class StepperBinsMonteCarloCounter {
+    CounterRandom random;
+
+    template<typename Result,std::size_t DIMBINS, typename Float, std::size_t DIM>
+    struct Samples {
+        vector_dimensions<Result,DIMBINS> summatory;
+        Range<Float,DIM> range;
+        unsigned long counter;
+        std::uint64_t stream;
+        Samples(std::array<std::size_t,DIMBINS> resolution, const Range<Float,DIM>& range) :
+            summatory(resolution,Result(0)),range(range),counter(0),stream(CounterRandom::stream_of(range)) { }
+    };
+public:
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using Result = decltype(f(range.min()));
+        return Samples<Result,DIMBINS,Float,DIM>(resolution, range);
+    }
+
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Result>
+    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        std::array<Float,DIM> sample = random.uniform(range,samples.stream,samples.counter);
+        if (samples.range.is_inside(sample)) {
+            std::array<std::size_t,DIMBINS> pos;
+            for (std::size_t i=0;i<DIMBINS;++i) {
+                pos[i] = std::size_t(resolution[i]*(sample[i] - samples.range.min(i))/(samples.range.max(i) - samples.range.min(i)));
+            }
+            samples.summatory[pos] += range.volume()*f(sample);
+        }
+        ++samples.counter;
+    }
+
+    template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Result>
+    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        for (auto pos : multidimensional_range(resolution))
+            bins(pos) = (samples.counter == 0)?samples.summatory[pos]:
+                samples.summatory[pos]*double(samples.summatory.size())/double(samples.counter);
+    }
+
+    //Checkpointing (see checkpoint.h). The seed is not saved: resuming with another seed is still correct.
+    template<typename Out, typename Result, std::size_t DIMBINS, typename Float, std::size_t DIM>
+    void checkpoint(Out& out, const Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        out.write(samples.summatory.raw_data()); out.write(samples.range); out.write(samples.counter); out.write(samples.stream);
+    }
+
+    template<typename In, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto resume(In& in, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using Result = decltype(f(range.min()));
+        std::vector<Result> summatory; in.read(summatory);
+        Samples<Result,DIMBINS,Float,DIM> samples(resolution, in.template read<Range<Float,DIM>>());
+        samples.summatory = vector_dimensions<Result,DIMBINS>(resolution,summatory);
+        in.read(samples.counter); in.read(samples.stream);
+        return samples;
+    }
+
+    void reseed(std::uint64_t seed) { random.reseed(seed); }
+
+    StepperBinsMonteCarloCounter(std::uint64_t seed) : random(seed) { }
+};
 
 template<typename RNG>
 auto stepper_monte_carlo_uniform(RNG&& rng) {
@@ -123,6 +272,14 @@ auto stepper_bins_monte_carlo_uniform(std::size_t seed = std::random_device()())
 }
 
 
+auto stepper_monte_carlo_counter(std::uint64_t seed = std::random_device()()) {
+    return StepperMonteCarloCounter(seed);
+}
+
+auto stepper_bins_monte_carlo_counter(std::uint64_t seed = std::random_device()()) {
+    return StepperBinsMonteCarloCounter(seed);
+}
+
 template<typename RNG>
 auto integrator_monte_carlo_uniform(RNG&& rng, unsigned long samples, 
     std::enable_if_t<!std::is_integral_v<RNG>,int> dummy = 0) {
@@ -143,6 +300,14 @@ auto integrator_bins_monte_carlo_uniform(unsigned long samples, std::size_t seed
     return integrator_bins_stepper(stepper_bins_monte_carlo_uniform(seed),samples);
 }
 
+auto integrator_monte_carlo_counter(unsigned long samples, std::uint64_t seed = std::random_device()()) {
+    return integrator_stepper(stepper_monte_carlo_counter(seed),samples);
+}
+
+auto integrator_bins_monte_carlo_counter(unsigned long samples, std::uint64_t seed = std::random_device()()) {
+    return integrator_bins_stepper(stepper_bins_monte_carlo_counter(seed),samples);
+}
+
 }
 
 
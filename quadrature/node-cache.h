@@ -0,0 +1,208 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <limits>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include "range.h"
+#include "batch.h"
+
+namespace viltrum {
+
+/**
+ * Function wrapper that remembers the values of the integrand on the nodes of a dyadic grid of the original range.
+ * Regions only copy the samples shared with their siblings when split, so nodes on faces shared with other neighbours
+ * (or reached through splits along different dimensions) would be evaluated again. All those nodes lie on the grid
+ * (for rules with dyadic nodes, such as trapezoidal, simpson or boole, split in halves), so they are looked up by
+ * their exact integer coordinates on it (2^levels cells per dimension) before calling the integrand. Points that are
+ * not on the grid (Gauss rules, splits in three) are evaluated directly.
+ *
+ * The table is split in shards, each one an open addressing hash table with its own lock, so it can be shared by
+ * parallel steppers. Tables start small and double when half full, so memory follows the nodes actually stored. When
+ * a shard is full, only the nodes used since the previous eviction (the current generation) are kept. Copies of the
+ * wrapper share the same cache.
+ **/
+template<typename F, typename Float, std::size_t DIM>
+class NodeCache {
+public:
+    using value_type = std::decay_t<decltype(std::declval<const F&>()(std::declval<const std::array<Float,DIM>&>()))>;
+    //Coordinates closer than a thousandth of a cell to a node are rounded to it (regions recompute their nodes from
+    //their own ranges, so the same node can differ in the last bits)
+    static constexpr int levels = std::min(32,std::numeric_limits<Float>::digits - 10);
+    static constexpr std::size_t initial_size = 64;
+
+private:
+    using key_type = std::array<std::uint64_t,DIM>;
+    struct Entry {
+        key_type key;
+        value_type value;
+        std::uint32_t generation = 0;
+        bool used = false;
+    };
+    struct Shard {
+        std::mutex mutex;
+        std::vector<Entry> table;
+        std::size_t count = 0;
+        std::uint32_t generation = 1;
+    };
+    struct State {
+        std::vector<Shard> shards;
+        std::size_t limit; //Entries per shard before eviction
+        std::atomic<unsigned long> hits{0}, evaluations{0}, evictions{0};
+        State(std::size_t nshards, std::size_t limit) : shards(nshards), limit(limit) {}
+    };
+
+    F f;
+    Range<Float,DIM> range;
+    std::shared_ptr<State> state;
+
+    bool key(const std::array<Float,DIM>& x, key_type& k) const {
+        constexpr double cells = double(std::uint64_t(1)<<levels);
+        for (std::size_t i = 0; i<DIM; ++i) {
+            double t = cells*double(x[i] - range.min(i))/double(range.max(i) - range.min(i));
+            double r = std::round(t);
+            if ((std::abs(t - r) > 1.e-3) || (r < 0) || (r > cells)) return false;
+            k[i] = std::uint64_t(r);
+        }
+        return true;
+    }
+
+    static std::uint64_t hash(const key_type& k) {
+        std::uint64_t h = 0x9e3779b97f4a7c15ULL;
+        for (auto ki : k) {
+            h ^= ki + 0x9e3779b97f4a7c15ULL + (h<<6) + (h>>2);
+            h = (h ^ (h>>30))*0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h>>27))*0x94d049bb133111ebULL;
+            h ^= h>>31;
+        }
+        return h;
+    }
+
+    Shard& shard(std::uint64_t h) const { return state->shards[(h>>48) % state->shards.size()]; }
+
+    //Slot of k in the table (the empty slot where it would go if it is not there)
+    static std::size_t slot(const Shard& s, const key_type& k, std::uint64_t h) {
+        std::size_t mask = s.table.size() - 1;
+        std::size_t i = std::size_t(h) & mask;
+        while (s.table[i].used && (s.table[i].key != k)) i = (i+1) & mask;
+        return i;
+    }
+
+    bool find(const key_type& k, std::uint64_t h, value_type& v) const {
+        Shard& s = shard(h);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.table.empty()) return false;
+        Entry& e = s.table[slot(s,k,h)];
+        if (!e.used) return false;
+        e.generation = s.generation;
+        v = e.value;
+        return true;
+    }
+
+    void insert(const key_type& k, std::uint64_t h, const value_type& v) const {
+        Shard& s = shard(h);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (s.count >= state->limit) evict(s);
+        else if (2*(s.count + 1) > s.table.size()) grow(s);
+        Entry& e = s.table[slot(s,k,h)];
+        if (!e.used) { e.used = true; e.key = k; ++s.count; }
+        e.value = v;
+        e.generation = s.generation;
+    }
+
+    //Rehashes the entries of the shard that satisfy keep into a table of the given size
+    template<typename Keep>
+    static void rebuild(Shard& s, std::size_t size, const Keep& keep) {
+        std::vector<Entry> old(size);
+        old.swap(s.table);
+        s.count = 0;
+        for (auto& e : old) if (e.used && keep(e)) {
+            std::uint64_t h = hash(e.key);
+            s.table[slot(s,e.key,h)] = std::move(e);
+            ++s.count;
+        }
+    }
+
+    //Doubles the table (it never needs more than twice the entries per shard)
+    void grow(Shard& s) const {
+        rebuild(s,std::max(initial_size,2*s.table.size()),[] (const Entry&) { return true; });
+    }
+
+    //Rebuilds the shard with the entries of the current generation (none if they are still more than half of it)
+    void evict(Shard& s) const {
+        std::size_t current = std::count_if(s.table.begin(),s.table.end(),[&s] (const Entry& e) { return e.used && (e.generation == s.generation); });
+        bool keep = (2*current <= state->limit);
+        rebuild(s,s.table.size(),[&s,keep] (const Entry& e) { return keep && (e.generation == s.generation); });
+        ++s.generation;
+        ++state->evictions;
+    }
+
+public:
+    NodeCache(const F& f, const Range<Float,DIM>& range, std::size_t max_nodes = std::size_t(1)<<20, std::size_t shards = 16) :
+            f(f), range(range), state(std::make_shared<State>(std::max<std::size_t>(shards,1),std::max<std::size_t>(max_nodes/std::max<std::size_t>(shards,1),1))) {}
+    NodeCache(F&& f, const Range<Float,DIM>& range, std::size_t max_nodes = std::size_t(1)<<20, std::size_t shards = 16) :
+            f(std::move(f)), range(range), state(std::make_shared<State>(std::max<std::size_t>(shards,1),std::max<std::size_t>(max_nodes/std::max<std::size_t>(shards,1),1))) {}
+
+    value_type operator()(const std::array<Float,DIM>& x) const {
+        key_type k;
+        if (!key(x,k)) { ++state->evaluations; return f(x); }
+        std::uint64_t h = hash(k);
+        value_type v;
+        if (find(k,h,v)) { ++state->hits; return v; }
+        //The integrand is evaluated outside the lock, other threads may do the same with the same node meanwhile
+        v = f(x);
+        ++state->evaluations;
+        insert(k,h,v);
+        return v;
+    }
+
+    //Only the nodes that are not in the cache go to the integrand's batch
+    template<typename FF = F, typename = std::enable_if_t<has_evaluate_batch_v<FF,Float,DIM,value_type>>>
+    void evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<value_type>& values) const {
+        std::vector<std::array<Float,DIM>> missing;
+        std::vector<std::size_t> positions;
+        std::vector<std::pair<key_type,std::uint64_t>> keys;
+        std::vector<bool> cached;
+        for (std::size_t i = 0; i<points.size(); ++i) {
+            key_type k;
+            bool on_grid = key(points[i],k);
+            std::uint64_t h = on_grid?hash(k):0;
+            if (on_grid && find(k,h,values[i])) { ++state->hits; continue; }
+            missing.push_back(points[i]); positions.push_back(i);
+            keys.emplace_back(k,h); cached.push_back(on_grid);
+        }
+        if (missing.empty()) return;
+        std::vector<value_type> computed(missing.size());
+        viltrum::evaluate_batch(f,missing,computed);
+        state->evaluations += missing.size();
+        for (std::size_t j = 0; j<missing.size(); ++j) {
+            if (cached[j]) insert(keys[j].first,keys[j].second,computed[j]);
+            values[positions[j]] = std::move(computed[j]);
+        }
+    }
+
+    //Calls to the integrand and values taken from the cache, shared by all the copies
+    unsigned long evaluations() const { return state->evaluations; }
+    unsigned long hits() const { return state->hits; }
+    unsigned long evictions() const { return state->evictions; }
+    //Slots allocated by all the tables
+    std::size_t capacity() const {
+        std::size_t c = 0;
+        for (auto& s : state->shards) { std::lock_guard<std::mutex> lock(s.mutex); c += s.table.size(); }
+        return c;
+    }
+    const F& function() const { return f; }
+};
+
+template<typename F, typename Float, std::size_t DIM>
+auto node_cache(F&& f, const Range<Float,DIM>& range, std::size_t max_nodes = std::size_t(1)<<20, std::size_t shards = 16) {
+    return NodeCache<std::decay_t<F>,Float,DIM>(std::forward<F>(f),range,max_nodes,shards);
+}
+
+}
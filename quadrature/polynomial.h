@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../multiarray/multiarray.h"
+#include "../multiarray/fold.h"
 #include "../multiarray/array.h"
 #include "range.h"
 #include "../quadrature/multidimensional-range.h"
@@ -37,8 +38,8 @@ struct Polynomial {
 		auto f = [&] (const auto& c) -> T {
 				return horner<0>::evaluate(x[N],c);
 			};
-        if constexpr (MA::dimensions > 1) return eval(ma.fold(f,N),x);
-		else return ma.fold(f,N).value(); 
+        if constexpr (MA::dimensions > 1) return eval(ma.fold_eager(f,N),x);
+		else return ma.fold_eager(f,N); 
 	}
 	
 	template<typename MA, std::size_t DIMSUB>
@@ -49,7 +50,7 @@ struct Polynomial {
 			auto f = [&] (const auto& c) -> T {
 				return horner<0>::evaluate_integral(Float(1),c);
 			};
-			return eval_integral(ma.fold(f,N),a,b);
+			return eval_integral(ma.fold_eager(f,N),a,b);
 		}
 		else {		
 			auto f = [&] (const auto& c) -> T {
@@ -57,8 +58,8 @@ struct Polynomial {
 						horner<0>::evaluate_integral(a[N],c);
 			};
 
-			if constexpr (MA::dimensions > 1) return eval_integral(ma.fold(f,N),a,b);
-			else return ma.fold(f,N).value();
+			if constexpr (MA::dimensions > 1) return eval_integral(ma.fold_eager(f,N),a,b);
+			else return ma.fold_eager(f,N);
 		}
 	}
 	
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <array>
+#include <random>
+#include <tuple>
+#include <cstdint>
+#include <unordered_map>
+#include "range.h"
+#include "random.h"
+#include "integrate.h"
+#include "integrate-bins-stepper.h"
+#include "vector-dimensions.h"
+#include "../utils/sobol.h"
+
+namespace viltrum {
+
+namespace detail {
+//Next index of the sequence of each scrambling (one per range). Steps on a single range skip the hash table.
+class SobolIndices {
+    std::uint64_t last_scramble = 0;
+    std::uint32_t last_index = 0;
+    bool started = false;
+    std::unordered_map<std::uint64_t,std::uint32_t> others;
+public:
+    std::uint32_t next(std::uint64_t scramble) {
+        if (started && (scramble != last_scramble)) {
+            others[last_scramble] = last_index;
+            auto it = others.find(scramble);
+            last_index = (it == others.end())?0:it->second;
+        }
+        started = true;
+        last_scramble = scramble;
+        return last_index++;
+    }
+};
+}
+
+/**
+ * Quasi Monte Carlo counterpart of StepperMonteCarloUniform: the samples are the points of an Owen-scrambled Sobol
+ * sequence mapped to the range. The scrambling is keyed on the seed and on the range given to each step, so that
+ * different regions or bins get independent randomizations. Each step takes the next point of the sequence of its
+ * range; the error decreases faster than with uniform samples for smooth integrands, especially after powers of two
+ * steps. As the residual stepper of the control variates, each step gets the range of the chosen region, so each
+ * region keeps its own sequence (and its own position in it) instead of scattering one sequence among all of them.
+ **/
+class StepperQuasiMonteCarlo {
+    std::uint64_t seed;
+
+    template<typename Result>
+    struct Samples {
+        Result sumatory;
+        unsigned long counter;
+        detail::SobolIndices indices;
+        Samples() : sumatory(0),counter(0) { }
+    };
+public:
+    template<typename F, typename Float, std::size_t DIM>
+    auto init(const F& f, const Range<Float,DIM>& range) const {
+        return Samples<decltype(f(range.min()))>();
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename Result>
+    void step(const F& f, const Range<Float,DIM>& range, Samples<Result>& samples) const {
+        std::uint64_t scramble = CounterRandom::stream_of(range,seed);
+        samples.sumatory += range.volume()*f(map_to_range(Sobol::uniform<Float,DIM>(samples.indices.next(scramble),scramble),range));
+        ++samples.counter;
+    }
+
+    template<typename F, typename Float, std::size_t DIM, typename Result>
+    Result integral(const F& f, const Range<Float,DIM>& range, const Samples<Result>& samples) const {
+        return (samples.counter==0)?decltype(samples.sumatory)(0):(samples.sumatory/double(samples.counter));
+    }
+
+    void reseed(std::uint64_t s) { seed = s; }
+
+    StepperQuasiMonteCarlo(std::uint64_t seed) : seed(seed) { }
+};
+
+class StepperBinsQuasiMonteCarlo {
+    std::uint64_t seed;
+
+    template<typename Result,std::size_t DIMBINS, typename Float, std::size_t DIM>
+    struct Samples {
+        vector_dimensions<Result,DIMBINS> summatory;
+        Range<Float,DIM> range;
+        unsigned long counter;
+        detail::SobolIndices indices;
+        Samples(std::array<std::size_t,DIMBINS> resolution, const Range<Float,DIM>& range) :
+            summatory(resolution,Result(0)),range(range),counter(0) { }
+    };
+public:
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM>
+    auto init(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range) const {
+        using Result = decltype(f(range.min()));
+        return Samples<Result,DIMBINS,Float,DIM>(resolution, range);
+    }
+
+    template<std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Result>
+    void step(const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        std::uint64_t scramble = CounterRandom::stream_of(range,seed);
+        std::array<Float,DIM> sample = map_to_range(Sobol::uniform<Float,DIM>(samples.indices.next(scramble),scramble),range);
+        if (samples.range.is_inside(sample)) {
+            std::array<std::size_t,DIMBINS> pos;
+            for (std::size_t i=0;i<DIMBINS;++i) {
+                pos[i] = std::min(resolution[i]-1,
+                    std::size_t(resolution[i]*(sample[i] - samples.range.min(i))/(samples.range.max(i) - samples.range.min(i))));
+            }
+            samples.summatory[pos] += range.volume()*f(sample);
+        }
+        ++samples.counter;
+    }
+
+    template<typename Bins, std::size_t DIMBINS, typename F, typename Float, std::size_t DIM, typename Result>
+    void integral(Bins& bins, const std::array<std::size_t,DIMBINS>& resolution, const F& f, const Range<Float,DIM>& range, const Samples<Result,DIMBINS,Float,DIM>& samples) const {
+        for (auto pos : multidimensional_range(resolution))
+            bins(pos) = (samples.counter == 0)?samples.summatory[pos]:
+                samples.summatory[pos]*double(samples.summatory.size())/double(samples.counter);
+    }
+
+    void reseed(std::uint64_t s) { seed = s; }
+
+    StepperBinsQuasiMonteCarlo(std::uint64_t seed) : seed(seed) { }
+};
+
+/**
+ * Sampler for the stratified control variates integrators (same interface as FunctionSampler). Each batch of
+ * samples taken within a range is a fresh randomization (seeded from rng) of the first points of the Owen-scrambled
+ * Sobol sequence, while single samples are just uniform.
+ **/
+class FunctionSamplerQuasiMonteCarlo {
+public:
+	template<typename F, typename Float, std::size_t DIM, typename RNG>
+	auto sample(const F& f, const Range<Float,DIM>& range, RNG& rng) const {
+		std::array<Float,DIM> sample = sample_uniform(rng,range);
+		return std::make_tuple(f(sample),sample);
+	}
+
+	//Calls g(value,sample) for each of the n samples
+	template<typename F, typename Float, std::size_t DIM, typename RNG, typename G>
+	void sample_batch(const F& f, const Range<Float,DIM>& range, RNG& rng, std::size_t n, const G& g) const {
+		std::uint64_t scramble = std::uniform_int_distribution<std::uint64_t>()(rng);
+		for (std::size_t i = 0; i<n; ++i) {
+			std::array<Float,DIM> sample = map_to_range(Sobol::uniform<Float,DIM>(std::uint32_t(i),scramble),range);
+			g(f(sample),sample);
+		}
+	}
+};
+
+auto stepper_quasi_monte_carlo(std::uint64_t seed = std::random_device()()) {
+    return StepperQuasiMonteCarlo(seed);
+}
+
+auto stepper_bins_quasi_monte_carlo(std::uint64_t seed = std::random_device()()) {
+    return StepperBinsQuasiMonteCarlo(seed);
+}
+
+auto integrator_quasi_monte_carlo(unsigned long samples, std::uint64_t seed = std::random_device()()) {
+    return integrator_stepper(stepper_quasi_monte_carlo(seed),samples);
+}
+
+auto integrator_bins_quasi_monte_carlo(unsigned long samples, std::uint64_t seed = std::random_device()()) {
+    return integrator_bins_stepper(stepper_bins_quasi_monte_carlo(seed),samples);
+}
+
+}
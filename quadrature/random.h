@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <random>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <type_traits>
+#include "range.h"
+#include "reseed.h"
+#include "../utils/philox.h"
+
+namespace viltrum {
+
+/**
+ * Random number generators that can produce a whole point of [0,1)^DIM in a single call, through
+ *
+ *     template<typename Float, std::size_t DIM> std::array<Float,DIM> uniform();
+ *
+ * (like Philox) are used through it. Any other generator goes through one std::uniform_real_distribution per
+ * dimension, as before, so the sequences of existing seeds do not change.
+ **/
+template<typename RNG, typename Float, std::size_t DIM, typename = void>
+struct has_uniform_array : std::false_type {};
+
+template<typename RNG, typename Float, std::size_t DIM>
+struct has_uniform_array<RNG,Float,DIM,std::void_t<decltype(std::declval<RNG&>().template uniform<Float,DIM>())>> : std::true_type {};
+
+template<typename Float, std::size_t DIM>
+std::array<Float,DIM> map_to_range(const std::array<Float,DIM>& u, const Range<Float,DIM>& range) {
+    std::array<Float,DIM> sample;
+    for (std::size_t i=0;i<DIM;++i) sample[i] = range.min(i) + u[i]*(range.max(i) - range.min(i));
+    return sample;
+}
+
+//Uniformly distributed point inside range
+template<typename RNG, typename Float, std::size_t DIM>
+std::array<Float,DIM> sample_uniform(RNG& rng, const Range<Float,DIM>& range) {
+    if constexpr (has_uniform_array<RNG,Float,DIM>::value) return map_to_range(rng.template uniform<Float,DIM>(),range);
+    else {
+        std::array<Float,DIM> sample;
+        for (std::size_t i=0;i<DIM;++i) {
+            std::uniform_real_distribution<Float> dis(range.min(i),range.max(i));
+            sample[i] = dis(rng);
+        }
+        return sample;
+    }
+}
+
+/**
+ * Stateless counter-based random source: the index-th random point of a stream is a pure function of
+ * (seed, stream, index). Steppers that use it keep the sample index in their data instead of a mutable generator,
+ * so they are const, thread-safe and reproducible regardless of the order in which samples are taken.
+ **/
+class CounterRandom {
+    std::uint64_t key;
+public:
+    CounterRandom(std::uint64_t seed = 0) : key(seed) { }
+
+    template<typename Float, std::size_t DIM>
+    std::array<Float,DIM> uniform(std::uint64_t stream, std::uint64_t index) const {
+        return Philox::uniform<Float,DIM>(key,stream,index);
+    }
+
+    template<typename Float, std::size_t DIM>
+    std::array<Float,DIM> uniform(const Range<Float,DIM>& range, std::uint64_t stream, std::uint64_t index) const {
+        return map_to_range(uniform<Float,DIM>(stream,index),range);
+    }
+
+    //Stream derived from the bits of a range, so that different regions or bins get uncorrelated samples
+    template<typename Float, std::size_t DIM>
+    static std::uint64_t stream_of(const Range<Float,DIM>& range, std::uint64_t stream = 0) {
+        for (std::size_t i=0;i<DIM;++i) for (Float x : {range.min(i),range.max(i)}) {
+            std::uint64_t bits = 0;
+            std::memcpy(&bits,&x,std::min(sizeof(x),sizeof(bits)));
+            stream = stream_seed(stream,bits);
+        }
+        return stream;
+    }
+
+    std::uint64_t seed() const { return key; }
+    void reseed(std::uint64_t seed) { key = seed; }
+};
+
+}
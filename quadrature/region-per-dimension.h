@@ -0,0 +1,343 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <cassert>
+#include <type_traits>
+#include <utility>
+#include "../multiarray/multiarray.h"
+#include "polynomial.h"
+#include "range.h"
+#include "rules.h"
+#include "nested.h"
+#include "batch.h"
+
+namespace viltrum {
+
+/**
+ * A different quadrature rule on each dimension, for integrands that are much smoother along some axes than along
+ * others. For instance
+ *
+ *     per_dimension(nested(simpson,trapezoidal),nested(simpson,trapezoidal),nested(boole,simpson))
+ *
+ * takes 3x3x5 samples per region instead of 5x5x5. It is used as any nested rule, and its regions are
+ * RegionPerDimension.
+ **/
+template<typename... Q>
+class PerDimension {
+    std::tuple<Q...> rules_;
+public:
+    static constexpr std::size_t dimensions = sizeof...(Q);
+    static constexpr std::array<std::size_t,dimensions> samples{{Q::samples...}};
+    static constexpr std::size_t max_samples = std::max({Q::samples...});
+    static constexpr std::size_t nodes = (Q::samples * ...);
+    static constexpr bool nested = (is_nested<Q>::value && ...);
+
+    template<std::size_t D>
+    using rule_type = std::tuple_element_t<D,std::tuple<Q...>>;
+
+    template<std::size_t D>
+    const rule_type<D>& rule() const { return std::get<D>(rules_); }
+
+    PerDimension(const Q&... q) : rules_(q...) { }
+};
+
+template<typename... Q>
+auto per_dimension(const Q&... q) {
+    return PerDimension<Q...>(q...);
+}
+
+/**
+ * Same as Region, but the samples along each dimension d are those of the rule Q::rule<d>(). The samples are stored
+ * contiguously with the first dimension changing faster, and every operation (estimates, approximation, subrange
+ * integrals, split and polynomial) applies on each dimension the rule of that dimension.
+ **/
+template<typename Float, typename Q, typename VT>
+class RegionPerDimension {
+    static constexpr std::size_t DIM = Q::dimensions;
+    Q quadrature;
+    Range<Float,DIM> _range;
+
+public:
+    using value_type = VT;
+    static constexpr std::size_t dimensions = DIM;
+    const Range<Float,DIM>& range() const {
+        return _range;
+    }
+
+private:
+    detail::multiarray_storage<value_type,Q::nodes> data;
+    value_type integral_;
+    value_type low_integral_;
+    std::array<value_type,DIM> errors_;
+
+    //Distance in the storage between consecutive samples on dimension d
+    static constexpr std::size_t stride(std::size_t d) { std::size_t s = 1; for (std::size_t i = 0; i<d; ++i) s*=Q::samples[i]; return s; }
+
+    template<std::size_t N, typename R>
+    static std::array<Float,Q::max_samples> weights(const R& r) {
+        std::array<Float,Q::max_samples> w; w.fill(Float(0));
+        for (std::size_t k = 0; k<N; ++k) {
+            std::array<Float,N> unit; unit.fill(Float(0)); unit[k] = Float(1);
+            w[k] = r(unit);
+        }
+        return w;
+    }
+
+    using Weights = std::array<std::array<Float,Q::max_samples>,DIM>;
+
+    template<std::size_t D>
+    void dimension_weights(Weights& w, Weights& l) const {
+        constexpr std::size_t n = Q::samples[D];
+        const auto& rule = quadrature.template rule<D>();
+        w[D] = weights<n>(rule);
+        if constexpr (Q::nested) l[D] = weights<n>([&] (const auto& p) { return rule.low(p); });
+    }
+
+    template<std::size_t... D>
+    void all_weights(Weights& w, Weights& l, std::index_sequence<D...>) const { (dimension_weights<D>(w,l), ...); }
+
+    //Same as Region::cache_estimates, with the weights of the rule of each dimension
+    void cache_estimates() {
+        Weights w, l, e;
+        all_weights(w,l,std::make_index_sequence<DIM>());
+        if constexpr (Q::nested)
+            for (std::size_t d = 0; d<DIM; ++d) for (std::size_t k = 0; k<Q::max_samples; ++k) e[d][k] = w[d][k] - l[d][k];
+
+        std::array<std::size_t,DIM> idx; idx.fill(0);
+        const value_type* v = data.values.data();
+        std::array<Float,DIM+1> prefix, suffix;
+        for (std::size_t n = 0; n<Q::nodes; ++n, ++v) {
+            prefix[0] = Float(1); suffix[DIM] = Float(1);
+            for (std::size_t i = 0; i<DIM; ++i) prefix[i+1] = prefix[i]*w[i][idx[i]];
+            for (std::size_t i = DIM; i>0; --i) suffix[i-1] = suffix[i]*w[i-1][idx[i-1]];
+            if (n==0) integral_ = prefix[DIM]*(*v); else integral_ += prefix[DIM]*(*v);
+            if constexpr (Q::nested) {
+                Float lw(1);
+                for (std::size_t i = 0; i<DIM; ++i) lw *= l[i][idx[i]];
+                if (n==0) low_integral_ = lw*(*v); else low_integral_ += lw*(*v);
+                for (std::size_t d = 0; d<DIM; ++d) {
+                    Float ew = prefix[d]*e[d][idx[d]]*suffix[d+1];
+                    if (n==0) errors_[d] = ew*(*v); else errors_[d] += ew*(*v);
+                }
+            }
+            for (std::size_t i = 0; (i<DIM) && (++idx[i] == Q::samples[i]); ++i) idx[i] = 0;
+        }
+
+        Float vol = range().volume();
+        integral_ = vol*integral_;
+        if constexpr (Q::nested) {
+            low_integral_ = vol*low_integral_;
+            for (std::size_t d = 0; d<DIM; ++d) errors_[d] = vol*errors_[d];
+        }
+    }
+
+    Float coordinate(std::size_t d, std::size_t index) const {
+        return range().min(d) + (Float(index)/Float(Q::samples[d]-1))*(range().max(d) - range().min(d));
+    }
+
+    template<typename F>
+    void fill_data(const F& f) {
+        std::vector<std::array<Float,DIM>> points(Q::nodes);
+        std::array<std::size_t,DIM> idx; idx.fill(0);
+        for (std::size_t n = 0; n<Q::nodes; ++n) {
+            for (std::size_t d = 0; d<DIM; ++d) points[n][d] = coordinate(d,idx[d]);
+            for (std::size_t i = 0; (i<DIM) && (++idx[i] == Q::samples[i]); ++i) idx[i] = 0;
+        }
+        std::vector<value_type> values;
+        evaluate_batch(f,points,values);
+        std::move(values.begin(),values.end(),data.values.begin());
+    }
+
+    //Folds the dimensions from D down to 0 of values (the samples on dimensions 0..D) with op(rule,samples,d), which
+    //reduces the samples of the rule of dimension d to a single value
+    template<std::size_t D, typename Op>
+    value_type fold(const value_type* values, const Op& op) const {
+        constexpr std::size_t n = Q::samples[D], inner = stride(D);
+        const auto& rule = quadrature.template rule<D>();
+        std::array<value_type,n> line;
+        if constexpr (D==0) {
+            for (std::size_t s = 0; s<n; ++s) line[s] = values[s];
+            return op(rule,line,D);
+        } else {
+            detail::multiarray_storage<value_type,inner> folded;
+            for (std::size_t j = 0; j<inner; ++j) {
+                for (std::size_t s = 0; s<n; ++s) line[s] = values[j + s*inner];
+                folded.values[j] = op(rule,line,D);
+            }
+            return fold<D-1>(folded.values.data(),op);
+        }
+    }
+
+    template<std::size_t D>
+    void coefficients_along(multiarray<value_type,Q::max_samples,DIM>& c) const {
+        constexpr std::size_t n = Q::samples[D];
+        const auto& rule = quadrature.template rule<D>();
+        std::array<std::size_t,DIM> resolution; resolution.fill(Q::max_samples); resolution[D] = 1;
+        std::array<value_type,n> line;
+        for (auto pos : multidimensional_range(resolution)) {
+            auto idx = pos;
+            for (std::size_t s = 0; s<n; ++s) { idx[D] = s; line[s] = c[idx]; }
+            auto coefficients = rule.coefficients(line);
+            for (std::size_t s = 0; s<n; ++s) { idx[D] = s; c[idx] = coefficients[s]; }
+        }
+    }
+
+    template<std::size_t... D>
+    void all_coefficients(multiarray<value_type,Q::max_samples,DIM>& c, std::index_sequence<D...>) const { (coefficients_along<D>(c), ...); }
+
+    constexpr Float volume_from(std::size_t start) const {
+        Float v(1);
+        for (std::size_t i = start; i<DIM; ++i) v*=std::abs(range().max(i) - range().min(i));
+        return v;
+    }
+
+    RegionPerDimension(const Q& q, const Range<Float,DIM>& r, detail::multiarray_storage<value_type,Q::nodes>&& d) :
+        quadrature(q), _range(r), data(std::move(d)) { cache_estimates(); }
+
+public:
+    template<typename F>
+    RegionPerDimension(const F& f, const Q& q, const Range<Float,DIM>& r) : quadrature(q), _range(r) {
+        fill_data(f);
+        cache_estimates();
+    }
+
+    const Q& quadrature_rule() const { return quadrature; }
+
+    //Checkpointing (see checkpoint.h): only the range and the samples are stored, the estimates are recomputed
+    template<typename Out>
+    void save(Out& out) const {
+        out.write(range());
+        out.write_values(data.values.data(),Q::nodes);
+    }
+
+    template<typename In>
+    static RegionPerDimension load(In& in, const Q& q) {
+        Range<Float,DIM> r = in.template read<Range<Float,DIM>>();
+        detail::multiarray_storage<value_type,Q::nodes> d;
+        in.read_values(d.values.data(),Q::nodes);
+        return RegionPerDimension(q,r,std::move(d));
+    }
+
+    value_type integral() const { return integral_; }
+
+    //If you do not reach the end it integrates in the other dimensions
+    template<std::size_t DIMSUB>
+    value_type approximation_at(const std::array<Float,DIMSUB>& pos) const {
+        static_assert(DIM>=DIMSUB,"Cannot approximate with bigger number of dimensions than the region");
+        const auto t = range().pos_in_range(pos);
+        return volume_from(DIMSUB)*fold<DIM-1>(data.values.data(),[&] (const auto& rule, const auto& samples, std::size_t d) -> value_type {
+            return (d<DIMSUB)?rule.at(t[d],samples):rule(samples); });
+    }
+
+    value_type approximation_at(Float pos) const {
+        return approximation_at(std::array<Float,1>{pos});
+    }
+
+    Polynomial<value_type,Float,Q::max_samples,DIM> polynomial() const {
+        //Coefficients of higher degree than the rule of their dimension are zero
+        multiarray<value_type,Q::max_samples,DIM> c(Float(0)*integral_);
+        std::array<std::size_t,DIM> idx; idx.fill(0);
+        for (std::size_t n = 0; n<Q::nodes; ++n) {
+            c[idx] = data.values[n];
+            for (std::size_t i = 0; (i<DIM) && (++idx[i] == Q::samples[i]); ++i) idx[i] = 0;
+        }
+        all_coefficients(c,std::make_index_sequence<DIM>());
+        return Polynomial<value_type,Float,Q::max_samples,DIM>(std::move(c),range());
+    }
+
+    template<std::size_t DIMSUB>
+    value_type integral_subrange(const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b) const {
+        static_assert(DIM>=DIMSUB,"Cannot calculate the subrange integral for that many dimensions, as the region has less dimensions");
+        const auto ta = range().pos_in_range(a), tb = range().pos_in_range(b);
+        return range().volume()*fold<DIM-1>(data.values.data(),[&] (const auto& rule, const auto& samples, std::size_t d) -> value_type {
+            return (d<DIMSUB)?rule.subrange(ta[d],tb[d],samples):rule(samples); });
+    }
+
+    template<std::size_t DIMSUB>
+    value_type integral_subrange(const Range<Float,DIMSUB>& subrange) const {
+        return integral_subrange(subrange.min(),subrange.max());
+    }
+
+    value_type integral_subrange(Float a, Float b) const {
+        return integral_subrange(std::array<Float,1>{a},std::array<Float,1>{b});
+    }
+
+    //Same as Region::split: samples shared with this region are copied, and the rest are evaluated in a single batch
+    template<typename F>
+    std::vector<RegionPerDimension> split(const F& f, std::size_t dimension = 0, std::size_t parts = 2) const {
+        assert(dimension < DIM);
+        const std::size_t n = Q::samples[dimension], full_size = parts*(n-1) + 1, st = stride(dimension);
+        std::vector<detail::multiarray_storage<value_type,Q::nodes>> subdatas(parts);
+        std::vector<std::array<Float,DIM>> points;
+        std::vector<std::tuple<std::size_t,std::size_t>> targets;
+        for (std::size_t part = 0; part<parts; ++part) {
+            std::array<std::size_t,DIM> idx; idx.fill(0);
+            for (std::size_t node = 0; node<Q::nodes; ++node) {
+                std::size_t i = part*(n-1) + idx[dimension];
+                if ((i%parts) == 0) //We copy the values
+                    subdatas[part].values[node] = data.values[node + (i/parts)*st - idx[dimension]*st];
+                else if ((idx[dimension] < (n-1)) || (part == (parts-1))) { //Merging points are copied afterwards
+                    std::array<Float,DIM> p;
+                    for (std::size_t d = 0; d<DIM; ++d) p[d] = coordinate(d,idx[d]);
+                    p[dimension] = range().min(dimension) + (Float(i)/Float(full_size-1))*(range().max(dimension) - range().min(dimension));
+                    points.push_back(p);
+                    targets.emplace_back(part,node);
+                }
+                for (std::size_t d = 0; (d<DIM) && (++idx[d] == Q::samples[d]); ++d) idx[d] = 0;
+            }
+        }
+        std::vector<value_type> values;
+        evaluate_batch(f,points,values);
+        for (std::size_t i = 0; i<targets.size(); ++i)
+            subdatas[std::get<0>(targets[i])].values[std::get<1>(targets[i])] = std::move(values[i]);
+        //We copy at the merging points (limits between two splitted regions)
+        for (std::size_t part = 1; part<parts; ++part)
+            for (std::size_t node = 0; node<Q::nodes; ++node)
+                if (((node/st)%n) == 0) subdatas[part-1].values[node + (n-1)*st] = subdatas[part].values[node];
+
+        std::vector<RegionPerDimension> sol; sol.reserve(parts);
+        std::array<Float,DIM> range_midmin = range().min();
+        std::array<Float,DIM> range_midmax = range().max();
+        Float d = (range().max(dimension) - range().min(dimension))/(Float(parts));
+        for (std::size_t i = 0; i<parts; ++i) {
+            range_midmax[dimension] = (i<(parts-1))?(range().min(dimension)+d*(i+1)):range().max(dimension);
+            sol.push_back(RegionPerDimension(quadrature,Range<Float,DIM>(range_midmin,range_midmax),std::move(subdatas[i])));
+            range_midmin[dimension] = range_midmax[dimension];
+        }
+        return sol;
+    }
+
+    template<typename QDT = Q, typename = typename std::enable_if<QDT::nested>::type >
+    value_type error(std::size_t dim) const {
+        assert(dim < DIM);
+        return errors_[dim];
+    }
+
+    //Error estimation on all dimensions at once
+    template<typename QDT = Q, typename = typename std::enable_if<QDT::nested>::type >
+    const std::array<value_type,DIM>& errors() const { return errors_; }
+
+    template<typename QDT = Q, typename = typename std::enable_if<QDT::nested>::type >
+    value_type error() const {
+        return integral_ - low_integral_;
+    }
+};
+
+template<typename Float, typename F, typename... Q, std::size_t DIM>
+auto region(const F& f, const PerDimension<Q...>& q,
+			const std::array<Float, DIM>& range_min,
+			const std::array<Float, DIM>& range_max) {
+	static_assert(DIM == sizeof...(Q),"There should be a quadrature rule per dimension");
+	return RegionPerDimension<Float,PerDimension<Q...>,std::decay_t<decltype(f(range_min))>>(f,q,Range<Float,DIM>(range_min,range_max));
+}
+
+template<typename Float, typename F, typename... Q, std::size_t DIM>
+auto region(const F& f, const PerDimension<Q...>& q, const Range<Float,DIM> range) {
+	static_assert(DIM == sizeof...(Q),"There should be a quadrature rule per dimension");
+	return RegionPerDimension<Float,PerDimension<Q...>,std::decay_t<decltype(f(range.min()))>>(f,q,range);
+}
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <vector>
+#include <tuple>
+#include <algorithm>
+#include <optional>
+#include "region.h"
+#include "../utils/compensated-sum.h"
+
+namespace viltrum {
+
+/**
+ * Flat storage for a set of regions of the same type R, meant to replace std::vector<ExtendedRegion<R,...>> in the
+ * adaptive steppers. All the samples of all the regions live in a single contiguous arena (indexed by region id), and
+ * ranges, integrals and split dimensions are stored in separate arrays. Ids of removed regions are reused. The heap
+ * only holds (error, id) pairs, so heap operations move a couple of words instead of whole regions.
+ *
+ * Regions are materialized (copied into a Region object) only when they are needed, for instance for splitting them.
+ * Those temporaries (and the halves returned by Region::split) still allocate, but they are freed once their
+ * samples are copied into the arena, so the number of live allocations does not grow with the number of regions.
+ **/
+template<typename R, typename Err>
+class RegionPool {
+public:
+    using region_type = R;
+    using value_type = typename R::value_type;
+    using error_type = Err;
+    using float_type = std::decay_t<decltype(std::declval<const R&>().range().min(0))>;
+    static constexpr std::size_t dimensions = R::dimensions;
+    using quadrature_type = std::decay_t<decltype(std::declval<const R&>().quadrature_rule())>;
+    static constexpr std::size_t samples_per_region = std::decay_t<decltype(std::declval<const R&>().samples())>::size;
+private:
+    static constexpr std::size_t power(std::size_t dim) { return (dim<=0)?1:samples_per_region*power(dim-1); }
+    static constexpr std::size_t nodes = power(dimensions);
+
+    quadrature_type quadrature;
+    std::vector<value_type> arena;
+    std::vector<Range<float_type,dimensions>> ranges;
+    std::vector<value_type> integrals;
+    std::vector<std::size_t> dims;
+    std::vector<std::size_t> free_ids;
+    std::vector<std::tuple<Err,std::size_t>> heap;
+    CompensatedSum<value_type> integral_total;
+    CompensatedSum<Err> error_total;
+
+    static bool compare(const std::tuple<Err,std::size_t>& a, const std::tuple<Err,std::size_t>& b) {
+        return std::get<0>(a) < std::get<0>(b);
+    }
+
+    std::size_t allocate(const R& r) {
+        if (!free_ids.empty()) { std::size_t id = free_ids.back(); free_ids.pop_back(); ranges[id] = r.range(); return id; }
+        std::size_t id = ranges.size();
+        arena.resize(arena.size()+nodes);
+        ranges.push_back(r.range()); integrals.emplace_back(); dims.push_back(0);
+        return id;
+    }
+
+public:
+    RegionPool(const quadrature_type& q) : quadrature(q) { }
+
+    void reserve(std::size_t n) {
+        arena.reserve(n*nodes); ranges.reserve(n); integrals.reserve(n); dims.reserve(n); heap.reserve(n);
+    }
+
+    //Stores a copy of the region with its error estimation and the dimension in which it should be split
+    std::size_t push(const R& r, const Err& err, std::size_t dim) {
+        std::size_t id = allocate(r);
+        std::copy(r.samples().raw_data(),r.samples().raw_data()+nodes,arena.begin()+id*nodes);
+        integrals[id] = r.integral(); dims[id] = dim;
+        integral_total += integrals[id]; error_total += err;
+        heap.emplace_back(err,id);
+        std::push_heap(heap.begin(),heap.end(),compare);
+        return id;
+    }
+
+    //Removes the region with the highest error from the heap. Its id is valid until the next push.
+    std::size_t pop() {
+        std::pop_heap(heap.begin(),heap.end(),compare);
+        std::size_t id = std::get<1>(heap.back());
+        integral_total -= integrals[id]; error_total -= std::get<0>(heap.back());
+        heap.pop_back();
+        free_ids.push_back(id);
+        return id;
+    }
+
+    std::size_t top() const { return std::get<1>(heap.front()); }
+    std::size_t size() const { return heap.size(); }
+    bool empty() const { return heap.empty(); }
+    //Running totals of the integral and error of the regions in the heap (O(1))
+    value_type integral() const { return integral_total.value(); }
+    Err error() const { return error_total.value(); }
+
+    R region(std::size_t id) const {
+        multiarray<value_type,samples_per_region,dimensions> data;
+        std::copy(arena.begin()+id*nodes,arena.begin()+(id+1)*nodes,data.raw_data());
+        return R(quadrature,ranges[id],std::move(data));
+    }
+    const Range<float_type,dimensions>& range(std::size_t id) const { return ranges[id]; }
+    const value_type& integral(std::size_t id) const { return integrals[id]; }
+    std::size_t split_dimension(std::size_t id) const { return dims[id]; }
+
+    //Handle to a stored region, with the same interface as a region for the most common queries.
+    //The region is only materialized (once per handle) when its samples are needed.
+    class entry {
+        const RegionPool* pool;
+        std::size_t id_;
+        mutable std::optional<R> materialized;
+    public:
+        entry(const RegionPool* p, std::size_t i) : pool(p), id_(i) { }
+        std::size_t id() const { return id_; }
+        const Range<float_type,dimensions>& range() const { return pool->range(id_); }
+        const value_type& integral() const { return pool->integral(id_); }
+        const R& region() const {
+            if (!materialized) materialized.emplace(pool->region(id_));
+            return *materialized;
+        }
+        template<typename... Args>
+        value_type integral_subrange(Args&&... args) const { return region().integral_subrange(std::forward<Args>(args)...); }
+        template<typename... Args>
+        value_type approximation_at(Args&&... args) const { return region().approximation_at(std::forward<Args>(args)...); }
+    };
+
+    //Iterates over the stored regions (in heap order)
+    class const_iterator {
+        const RegionPool* pool;
+        typename std::vector<std::tuple<Err,std::size_t>>::const_iterator it;
+    public:
+        const_iterator(const RegionPool* p, typename std::vector<std::tuple<Err,std::size_t>>::const_iterator i) : pool(p), it(i) { }
+        entry operator*() const { return entry(pool,std::get<1>(*it)); }
+        const_iterator& operator++() { ++it; return *this; }
+        bool operator==(const const_iterator& that) const { return it == that.it; }
+        bool operator!=(const const_iterator& that) const { return it != that.it; }
+    };
+
+    const_iterator begin() const { return const_iterator(this,heap.begin()); }
+    const_iterator end() const { return const_iterator(this,heap.end()); }
+};
+
+}
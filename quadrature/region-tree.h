@@ -0,0 +1,171 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include "range.h"
+
+namespace viltrum {
+
+/**
+ * Tree of the splits that produced a partition of a range into regions (such as the regions of StepperAdaptive), for
+ * locating the region that contains a point in O(depth) and integrating the approximations of the regions over a
+ * subrange visiting only the regions that overlap it. It is rebuilt from the ranges of the regions: each node splits
+ * its box at the middle of one dimension (so a partition from halving gives back the splits of the stepper), or, if
+ * no middle plane leaves all the regions on one side, at any plane that does. It only stores indices into the
+ * container of regions, which should not change afterwards.
+ *
+ * The nodes are stored in preorder in a single vector: the first child of a node is the next node, and the node
+ * keeps the index of the second one. Each node also keeps the integral of all the regions below it, so subtrees that
+ * are inside the subrange are not visited.
+ **/
+template<typename R>
+class RegionTree {
+public:
+    using value_type = typename R::value_type;
+    using Float = std::decay_t<decltype(std::declval<const R&>().range().min(0))>;
+    static constexpr std::size_t dimensions = R::dimensions;
+
+private:
+    struct Node {
+        Float split;
+        std::uint32_t dimension; //dimensions for leaves
+        std::size_t index;       //Second child, or the region for leaves
+        value_type integral;
+    };
+    std::vector<Node> nodes;
+    Range<Float,dimensions> root;
+
+    bool leaf(const Node& n) const { return n.dimension == dimensions; }
+
+    //Splits boxes [begin,end) into those below and above a plane, returning the first one above
+    template<typename Regions>
+    std::size_t choose_split(const Regions& regions, std::vector<std::size_t>& boxes, std::size_t begin, std::size_t end,
+            const Range<Float,dimensions>& box, std::size_t& dimension, Float& split) const {
+        std::size_t n = end - begin, best = 0, middle = 0;
+        for (std::size_t d = 0; d<dimensions; ++d) {
+            Float mid = (box.min(d) + box.max(d))/Float(2);
+            Float tolerance = (box.max(d) - box.min(d))*Float(1.e-6);
+            std::size_t nlow = 0; bool crosses = false;
+            for (std::size_t j = begin; (j<end) && !crosses; ++j) {
+                const auto& r = regions[boxes[j]].range();
+                if (r.max(d) <= (mid + tolerance)) ++nlow;
+                else crosses = (r.min(d) < (mid - tolerance));
+            }
+            if (!crosses && (std::min(nlow,n - nlow) > best)) { best = std::min(nlow,n - nlow); dimension = d; split = mid; }
+        }
+        if (best == 0) { //Not from halving: sweep each dimension for a plane that no region crosses
+            for (std::size_t d = 0; d<dimensions; ++d) {
+                Float tolerance = (box.max(d) - box.min(d))*Float(1.e-6);
+                std::sort(boxes.begin()+begin,boxes.begin()+end,[&] (std::size_t a, std::size_t b) {
+                    return regions[a].range().min(d) < regions[b].range().min(d); });
+                Float reach = regions[boxes[begin]].range().max(d);
+                for (std::size_t j = begin+1; j<end; ++j) {
+                    Float next = regions[boxes[j]].range().min(d);
+                    if ((reach <= (next + tolerance)) && (std::min(j - begin,end - j) > best)) {
+                        best = std::min(j - begin,end - j); dimension = d; split = next;
+                    }
+                    reach = std::max(reach,regions[boxes[j]].range().max(d));
+                }
+            }
+            if (best == 0) throw std::invalid_argument("RegionTree: the regions are not a partition made of splits");
+        }
+        Float tolerance = (box.max(dimension) - box.min(dimension))*Float(1.e-6);
+        middle = std::size_t(std::partition(boxes.begin()+begin,boxes.begin()+end,[&] (std::size_t b) {
+            return regions[b].range().max(dimension) <= (split + tolerance); }) - boxes.begin());
+        return middle;
+    }
+
+public:
+    RegionTree() : root(std::array<Float,dimensions>{},std::array<Float,dimensions>{}) { }
+
+    template<typename Regions>
+    RegionTree(const Regions& regions) : root(regions.begin()->range()) {
+        std::array<Float,dimensions> a = root.min(), b = root.max();
+        for (const auto& r : regions)
+            for (std::size_t d = 0; d<dimensions; ++d) { a[d] = std::min(a[d],r.range().min(d)); b[d] = std::max(b[d],r.range().max(d)); }
+        root = Range<Float,dimensions>(a,b);
+
+        std::vector<std::size_t> boxes(regions.size());
+        for (std::size_t i = 0; i<boxes.size(); ++i) boxes[i] = i;
+        nodes.reserve(2*regions.size());
+        //Explicit stack (partitions refined towards a point can be deep): the first child is always built next
+        struct Task { std::size_t begin, end, parent; Range<Float,dimensions> box; };
+        std::vector<Task> stack{Task{0,boxes.size(),nodes.max_size(),root}};
+        while (!stack.empty()) {
+            Task task = stack.back(); stack.pop_back();
+            std::size_t i = nodes.size();
+            if (task.parent < nodes.size()) nodes[task.parent].index = i;
+            if ((task.end - task.begin) == 1) {
+                nodes.push_back(Node{Float(0),std::uint32_t(dimensions),boxes[task.begin],regions[boxes[task.begin]].integral()});
+                continue;
+            }
+            std::size_t dimension = 0; Float split = 0;
+            std::size_t middle = choose_split(regions,boxes,task.begin,task.end,task.box,dimension,split);
+            nodes.push_back(Node{split,std::uint32_t(dimension),0,regions[boxes[task.begin]].integral()});
+            stack.push_back(Task{middle,task.end,i,task.box.subrange_dimension(dimension,split,task.box.max(dimension))});
+            stack.push_back(Task{task.begin,middle,nodes.max_size(),task.box.subrange_dimension(dimension,task.box.min(dimension),split)});
+        }
+        //Children are after their parents
+        for (std::size_t i = nodes.size(); i-->0;)
+            if (!leaf(nodes[i])) nodes[i].integral = nodes[i+1].integral + nodes[nodes[i].index].integral;
+    }
+
+    //Index of the region that contains x (points outside the partition go to a region at its boundary)
+    std::size_t locate(const std::array<Float,dimensions>& x) const {
+        std::size_t i = 0;
+        while (!leaf(nodes[i])) i = (x[nodes[i].dimension] < nodes[i].split)?(i+1):nodes[i].index;
+        return nodes[i].index;
+    }
+
+    //Sum of the integral_subrange of all the regions (the subrange may cover only the first dimensions)
+    template<typename Regions, std::size_t DIMSUB>
+    value_type integral_subrange(const Regions& regions, const Range<Float,DIMSUB>& range) const {
+        constexpr std::size_t K = std::min(DIMSUB,dimensions);
+        auto empty = regions[0].range().intersection(range);
+        value_type sol = regions[0].integral_subrange(decltype(empty)(empty.min(),empty.min())); //Zero of value_type
+        struct Task { std::size_t node; Range<Float,dimensions> box; };
+        std::vector<Task> stack{Task{0,root}};
+        while (!stack.empty()) {
+            Task task = stack.back(); stack.pop_back();
+            bool inside = true, outside = false;
+            for (std::size_t d = 0; d<K; ++d) {
+                inside = inside && (range.min(d) <= task.box.min(d)) && (range.max(d) >= task.box.max(d));
+                outside = outside || (range.min(d) >= task.box.max(d)) || (range.max(d) <= task.box.min(d));
+            }
+            const Node& n = nodes[task.node];
+            if (outside) continue;
+            else if (inside) sol += n.integral;
+            else if (leaf(n)) sol += regions[n.index].integral_subrange(regions[n.index].range().intersection(range));
+            else {
+                stack.push_back(Task{task.node+1,task.box.subrange_dimension(n.dimension,task.box.min(n.dimension),n.split)});
+                stack.push_back(Task{n.index,task.box.subrange_dimension(n.dimension,n.split,task.box.max(n.dimension))});
+            }
+        }
+        return sol;
+    }
+
+    value_type integral() const { return nodes.front().integral; }
+    std::size_t size() const { return nodes.size(); }
+
+    std::size_t depth() const {
+        std::size_t deepest = 0;
+        std::vector<std::array<std::size_t,2>> stack{std::array<std::size_t,2>{0,1}};
+        while (!stack.empty()) {
+            auto [i,level] = stack.back(); stack.pop_back();
+            deepest = std::max(deepest,level);
+            if (!leaf(nodes[i])) { stack.push_back({i+1,level+1}); stack.push_back({nodes[i].index,level+1}); }
+        }
+        return deepest;
+    }
+};
+
+template<typename Regions>
+RegionTree<typename Regions::value_type> region_tree(const Regions& regions) {
+    return RegionTree<typename Regions::value_type>(regions);
+}
+
+}
@@ -11,6 +11,7 @@
 #include "range.h"
 #include "rules.h"
 #include "nested.h"
+#include "batch.h"
 #include <cmath>
 
 namespace viltrum {
@@ -30,6 +31,62 @@ public:
 	
 private:
 	multiarray<value_type,Q::samples,DIM> data;
+	//Cached on construction (see cache_estimates) because the adaptive heuristics query them very often
+	value_type integral_;
+	value_type low_integral_;
+	std::array<value_type,DIM> errors_;
+
+	//Weights that the rule R gives to each sample, obtained by applying it to unit vectors
+	template<typename R>
+	static std::array<Float,Q::samples> weights(const R& r) {
+		std::array<Float,Q::samples> w;
+		for (std::size_t k = 0; k<Q::samples; ++k) {
+			std::array<Float,Q::samples> unit; unit.fill(Float(0)); unit[k] = Float(1);
+			w[k] = r(unit);
+		}
+		return w;
+	}
+
+	//Integral, low rule integral and the error on each dimension in a single pass over the samples. For each sample 
+	//the weight of the error on dimension d is the product of the weights of the rule on all the other dimensions 
+	//times the error weight on d, computed with prefix and suffix products.
+	void cache_estimates() {
+		const std::array<Float,Q::samples> w = weights(quadrature);
+		std::array<Float,Q::samples> l{}, e{};
+		if constexpr (is_nested<Q>::value) {
+			l = weights([&] (const auto& p) { return quadrature.low(p); });
+			for (std::size_t k = 0; k<Q::samples; ++k) e[k] = w[k] - l[k];
+		}
+		
+		std::array<std::size_t,DIM> idx; idx.fill(0);
+		const value_type* v = data.raw_data();
+		std::array<Float,DIM+1> prefix, suffix;
+		for (std::size_t n = 0; n<nodes(); ++n, ++v) {
+			prefix[0] = Float(1); suffix[DIM] = Float(1);
+			for (std::size_t i = 0; i<DIM; ++i) prefix[i+1] = prefix[i]*w[idx[i]];
+			for (std::size_t i = DIM; i>0; --i) suffix[i-1] = suffix[i]*w[idx[i-1]];
+			if (n==0) integral_ = prefix[DIM]*(*v); else integral_ += prefix[DIM]*(*v);
+			if constexpr (is_nested<Q>::value) {
+				Float lw(1);
+				for (std::size_t i = 0; i<DIM; ++i) lw *= l[idx[i]];
+				if (n==0) low_integral_ = lw*(*v); else low_integral_ += lw*(*v);
+				for (std::size_t d = 0; d<DIM; ++d) {
+					Float ew = prefix[d]*e[idx[d]]*suffix[d+1];
+					if (n==0) errors_[d] = ew*(*v); else errors_[d] += ew*(*v);
+				}
+			}
+			for (std::size_t i = 0; (i<DIM) && (++idx[i] == Q::samples); ++i) idx[i] = 0;
+		}
+
+		Float vol = range().volume();
+		integral_ = vol*integral_;
+		if constexpr (is_nested<Q>::value) {
+			low_integral_ = vol*low_integral_;
+			for (std::size_t d = 0; d<DIM; ++d) errors_[d] = vol*errors_[d];
+		}
+	}
+
+	static constexpr std::size_t nodes() { std::size_t n = 1; for (std::size_t i = 0; i<DIM; ++i) n*=Q::samples; return n; }
 	
 	template<typename F>
 	constexpr auto f_in_range(const F& f) const { 
@@ -41,6 +98,22 @@ private:
 		}); 
 	}
 	
+	template<typename F>
+	constexpr auto batch_in_range(const F& f) const {
+		return([&] (const std::vector<std::array<double,DIM>>& ps, std::vector<value_type>& values) {
+			std::vector<std::array<Float,DIM>> pranges(ps.size());
+			for (std::size_t j = 0; j<ps.size(); ++j) for (std::size_t i = 0; i<DIM; ++i)
+				pranges[j][i] = ps[j][i]*(range().max(i) - range().min(i)) + range().min(i);
+			evaluate_batch(f,pranges,values);
+		});
+	}
+
+	template<typename F>
+	void fill_data(const F& f) {
+		if constexpr (has_evaluate_batch_v<F,Float,DIM,value_type>) data.fill_batch(this->batch_in_range(f));
+		else data.fill(this->f_in_range(f));
+	}
+
 	constexpr Float volume_from(std::size_t start) const {
 		Float v(1); 
 		for (std::size_t i = start; i<DIM; ++i) v*=std::abs(range().max(i) - range().min(i));
@@ -52,44 +125,59 @@ public:
 			const std::array<Float, DIM>& range_max,
 			multiarray<value_type,Q::samples,DIM>&& d) : 
 				quadrature(q), _range(range_min, range_max), 
-				data(std::forward<multiarray<value_type,Q::samples,DIM>>(d)) { }
+				data(std::forward<multiarray<value_type,Q::samples,DIM>>(d)) { cache_estimates(); }
 
 	template<typename F>
 	Region(const F& f, const Q& q, 
 			const std::array<Float, DIM>& range_min, 
 			const std::array<Float, DIM>& range_max) : 
 				quadrature(q), _range(range_min, range_max) {
-		data.fill(this->f_in_range(f));
+		fill_data(f);
+		cache_estimates();
 	}
     
 	Region(const Q& q, const Range<Float,DIM>& r, multiarray<value_type,Q::samples,DIM>&& d) : 
 				quadrature(q), _range(r), 
-				data(std::forward<multiarray<value_type,Q::samples,DIM>>(d)) { }
+				data(std::forward<multiarray<value_type,Q::samples,DIM>>(d)) { cache_estimates(); }
 
 	template<typename F>
 	Region(const F& f, const Q& q, const Range<Float,DIM>& r) : 
 				quadrature(q), _range(r) {
-		data.fill(this->f_in_range(f));
+		fill_data(f);
+		cache_estimates();
 	}
 
     const Q& quadrature_rule() const { return quadrature; }
+    const multiarray<value_type,Q::samples,DIM>& samples() const { return data; }
+
+	//Checkpointing (see checkpoint.h): only the range and the samples are stored, the estimates are recomputed
+	template<typename Out>
+	void save(Out& out) const {
+		out.write(range());
+		out.write_values(data.raw_data(),nodes());
+	}
+
+	template<typename In>
+	static Region load(In& in, const Q& q) {
+		Range<Float,DIM> r = in.template read<Range<Float,DIM>>();
+		multiarray<value_type,Q::samples,DIM> d;
+		in.read_values(d.raw_data(),nodes());
+		return Region(q,r,std::move(d));
+	}
 	
-	value_type integral() const { return range().volume()*data.fold_all(quadrature); }
+	value_type integral() const { return integral_; }
 	
 private:
-	//Allegedly starts at 0
+	//Folds the first dimension of ma (which is dimension DIM - MA::dimensions of the region) until reaching DIMSUB
 	template<typename MA, std::size_t DIMSUB>
-	value_type app_at(const MA& ma, const std::array<Float,DIMSUB>& pos, 
-			std::enable_if_t<MA::dimensions <= (DIM-DIMSUB+1)>* p = nullptr) const {
-		return ma.fold([&] (const auto& v) 
-				{ return quadrature.at(pos[DIMSUB - 1],v);}).fold_all(quadrature)*volume_from(DIMSUB);
-	}
-	
-	template<typename MA, std::size_t DIMSUB>
-	auto app_at(const MA& ma, const std::array<Float,DIMSUB>& pos, 
-			std::enable_if_t<MA::dimensions >= ((DIM-DIMSUB)+2)>* p = nullptr) const {
-		return app_at(ma.fold([&] (const auto& v) 
-				{ return quadrature.at(pos[DIMSUB - MA::dimensions],v); }),pos);
+	value_type app_at(const MA& ma, const std::array<Float,DIMSUB>& pos) const {
+		constexpr std::size_t d = DIM - MA::dimensions;
+		if constexpr (d >= DIMSUB) return ma.fold_all(quadrature)*volume_from(DIMSUB);
+		else {
+			auto folded = ma.fold_eager([&] (const auto& v) { return quadrature.at(pos[d],v); });
+			if constexpr (MA::dimensions > 1) return app_at(folded,pos);
+			else return folded*volume_from(DIMSUB);
+		}
 	}
 
 public:
@@ -112,22 +200,17 @@ public:
 	}
 	
 private:
-	//Starts from 0
+	//Folds the first dimension of ma (which is dimension DIM - MA::dimensions of the region) until reaching DIMSUB
 	template<typename MA, std::size_t DIMSUB>
-	value_type sub_first(const MA& ma,  
-			const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b, 
-			std::enable_if_t<MA::dimensions <= (DIM-DIMSUB+1)>* p = nullptr) const {
-		return ma.fold([&] (const auto& v) 
-			{ return quadrature.subrange(a[DIMSUB - 1], b[DIMSUB - 1],v); }).fold_all(quadrature);
-	}
-	
-	//Allegedly starts at 0
-	template<typename MA, std::size_t DIMSUB>
-	auto sub_first(const MA& ma, 
-			const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b, 
-			std::enable_if_t<MA::dimensions >= ((DIM-DIMSUB)+2)>* p = nullptr) const {
-		return sub_first(ma.fold([&] (const auto& v) 
-			{ return quadrature.subrange(a[DIMSUB - MA::dimensions], b[DIMSUB- MA::dimensions],v);}),a,b);
+	value_type sub_first(const MA& ma, 
+			const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b) const {
+		constexpr std::size_t d = DIM - MA::dimensions;
+		if constexpr (d >= DIMSUB) return ma.fold_all(quadrature);
+		else {
+			auto folded = ma.fold_eager([&] (const auto& v) { return quadrature.subrange(a[d], b[d],v); });
+			if constexpr (MA::dimensions > 1) return sub_first(folded,a,b);
+			else return folded;
+		}
 	}
 public:
 	template<std::size_t DIMSUB>
@@ -142,11 +225,11 @@ private:
 	value_type sub_last(const MA& ma, 
 			const std::array<Float,DIMSUB>& a, const std::array<Float,DIMSUB>& b) const {
         if constexpr (MA::dimensions > DIMSUB)
-            return sub_last(ma.fold(quadrature,DIMSUB),a,b);
+            return sub_last(ma.fold_eager(quadrature,DIMSUB),a,b);
         else if constexpr (MA::dimensions > 1)
-            return sub_last(ma.fold([&] (const auto& v) { return quadrature.subrange(a[MA::dimensions-1],b[MA::dimensions-1],v); },MA::dimensions-1),a,b);
+            return sub_last(ma.fold_eager([&] (const auto& v) { return quadrature.subrange(a[MA::dimensions-1],b[MA::dimensions-1],v); },MA::dimensions-1),a,b);
         else
-            return ma.fold([&] (const auto& v) { return quadrature.subrange(a[0],b[0],v); }).value();
+            return ma.fold_eager([&] (const auto& v) { return quadrature.subrange(a[0],b[0],v); });
 	}
 public:
 	template<std::size_t DIMSUB>
@@ -175,7 +258,10 @@ public:
 	template<typename F>
 	std::vector<Region<Float,Q,DIM,value_type>> split(const F& f, std::size_t dimension = 0, std::size_t parts = 2) const {
 		assert(dimension < DIM);
-		auto subdatas = data.split(f_in_range(f),dimension,parts);
+		auto subdatas = [&] () {
+			if constexpr (has_evaluate_batch_v<F,Float,DIM,value_type>) return data.split_batch(batch_in_range(f),dimension,parts);
+			else return data.split(f_in_range(f),dimension,parts);
+		}();
 		std::vector<Region<Float,Q,DIM,value_type>> sol; sol.reserve(parts);
 		std::array<Float,DIM> range_midmin = range().min();
 		std::array<Float,DIM> range_midmax = range().max();
@@ -209,10 +295,12 @@ public:
 	template<typename QDT = Q, typename = typename std::enable_if<is_nested<QDT>::value>::type >
 	value_type error(std::size_t dim) const {
 		assert(dim < DIM);
-		return range().volume()*
-			data.fold([&] (const auto& v) { return quadrature.error(v); },dim)
-			    .fold_all(quadrature);
+		return errors_[dim];
 	}
+
+	//Error estimation on all dimensions at once
+	template<typename QDT = Q, typename = typename std::enable_if<is_nested<QDT>::value>::type >
+	const std::array<value_type,DIM>& errors() const { return errors_; }
 	
 	/*
 	 * Norm :: value_type -> Float
@@ -238,8 +326,7 @@ public:
 
 	template<typename QDT = Q, typename = typename std::enable_if<is_nested<QDT>::value>::type >
 	value_type error() const {
-		return range().volume()*(data.fold_all(quadrature) - 
-					   data.fold_all([&] (const auto& v) { return quadrature.low(v); }));
+		return integral_ - low_integral_;
 	}		
 };
 
@@ -265,6 +352,16 @@ public:
 	ExtendedRegion(const R& r, const E& e) : R(r), e(e) { }
 	
 	const E& extra() const { return e; }
+
+	template<typename Out>
+	void save(Out& out) const { R::save(out); out.write(e); }
+
+	template<typename In, typename... Args>
+	static ExtendedRegion load(In& in, const Args&... args) {
+		R r = R::load(in,args...);
+		E extra; in.read(extra);
+		return ExtendedRegion(std::move(r),std::move(extra));
+	}
 };
 
 }
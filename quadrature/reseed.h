@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+namespace viltrum {
+
+/**
+ * Steppers and integrators that own a random number generator can provide
+ *
+ *     void reseed(std::uint64_t seed);
+ *
+ * which restarts their generator from seed. Parallel integrators copy them for each block of work and reseed the
+ * copy with a stream seed derived from their own seed and the index of the block, so the result does not depend on
+ * which thread (or how many threads) processes each block. Copying something that owns a generator but cannot be
+ * reseeded would repeat the same random numbers on every copy, so it does not compile (see holds_rng).
+ **/
+template<typename T, typename = void>
+struct has_reseed : std::false_type {};
+
+template<typename T>
+struct has_reseed<T,std::void_t<decltype(std::declval<T&>().reseed(std::uint64_t(0)))>> : std::true_type {};
+
+template<typename T>
+constexpr bool has_reseed_v = has_reseed<T>::value;
+
+//Uniform random bit generators (the standard engines, Philox)
+template<typename T, typename = void>
+struct is_random_engine : std::false_type {};
+
+template<typename T>
+struct is_random_engine<T,std::void_t<typename T::result_type,decltype(T::min()),decltype(T::max()),decltype(std::declval<T&>()())>> : std::true_type {};
+
+//Whether T owns a random number generator: it is one, or one of its template arguments owns one (steppers and
+//samplers are templated on their generators, and wrappers on what they wrap)
+template<typename T>
+struct holds_rng : is_random_engine<T> {};
+
+template<template<typename...> class C, typename... Args>
+struct holds_rng<C<Args...>> : std::bool_constant<is_random_engine<C<Args...>>::value || (holds_rng<Args>::value || ...)> {};
+
+template<typename T>
+constexpr bool holds_rng_v = holds_rng<T>::value;
+
+//Seed of the stream-th independent stream from seed (splitmix64 finalizer, so neighbouring streams are uncorrelated)
+inline std::uint64_t stream_seed(std::uint64_t seed, std::uint64_t stream) {
+    std::uint64_t z = seed + (stream+1)*0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+//Restarts t from seed (nothing to do if t has no random number generator)
+template<typename T>
+void reseed_random(T& t, std::uint64_t seed) {
+    static_assert(has_reseed_v<T> || !holds_rng_v<T>,"It owns a random number generator but has no reseed: its copies would repeat the same random numbers");
+    if constexpr (has_reseed_v<T>) t.reseed(seed);
+}
+
+//Copy of t restarted from seed (just a copy if t has no random number generator)
+template<typename T>
+T reseeded(const T& t, std::uint64_t seed) {
+    T copy(t);
+    reseed_random(copy,seed);
+    return copy;
+}
+
+}
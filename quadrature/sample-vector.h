@@ -1,6 +1,11 @@
 #pragma once
 
 #include <random>
+#include <vector>
+#include <cstdint>
+#include <tuple>
+#include <algorithm>
+#include <type_traits>
 
 namespace viltrum {
 
@@ -20,15 +25,31 @@ class VectorSamplerUniform {
 		
 		Sampler(const RNG& r, std::size_t s) : rng(r), size(s) {}
 		Sampler() {} //This makes things easier although I don't like it
+
+		//Checkpointing (see checkpoint.h)
+		template<typename Out>
+		void save(Out& out) const { out.write(rng); out.write(std::uint64_t(size)); }
+		template<typename In>
+		void load(In& in) { in.read(rng); size = std::size_t(in.template read<std::uint64_t>()); }
 	};
 
 public:
-	template<typename T>
-	Sampler operator()(const std::vector<T>& v) const {
+	//Any container with size() (a vector, or a bin of a BinIndex)
+	template<typename V>
+	Sampler operator()(const V& v) const {
 		std::uniform_int_distribution<std::size_t> choose(0,10000000);
 		return Sampler(RNG(choose(rng)),v.size());
 	}
 
+	template<typename Out>
+	void save(Out& out) const { out.write(rng); }
+	template<typename In>
+	void load(In& in) { in.read(rng); }
+
+	//See reseed.h. Not available when the generator is a reference, as copies of the sampler share it
+	template<typename R = RNG, typename = std::enable_if_t<!std::is_reference_v<R>>>
+	void reseed(std::uint64_t seed) { rng.seed(seed); }
+
     VectorSamplerUniform(RNG&& r) : rng(std::forward<RNG>(r)) { }
 };
 
@@ -41,6 +62,116 @@ auto vector_sampler_uniform(std::size_t seed = std::random_device()()) {
     return vector_sampler_uniform(std::mt19937_64(seed));
 }
 
+namespace detail {
+template<typename T>
+const T& vector_element(const T& t) { return t; }
+template<typename T>
+const T& vector_element(const T* t) { return *t; }
+}
+
+/**
+ * Chooses the elements of a vector (typically regions) with probability proportional to weight(element), using a
+ * Walker/Vose alias table built in O(N), so each sample is O(1). To keep the estimator unbiased when some weights
+ * are zero (or underestimated), the weighted probabilities are mixed with the uniform ones by a factor
+ * uniform_mixture. The probability returned is the exact one of the chosen element.
+ **/
+template<typename RNG, typename Weight>
+class VectorSamplerWeighted {
+	mutable RNG rng;
+	Weight weight;
+	double uniform_mixture;
+
+	class Sampler {
+		mutable RNG rng;
+		std::vector<double> probability;
+		std::vector<double> threshold;
+		std::vector<std::size_t> alias;
+	public:
+		//Returns position and probability
+		std::tuple<std::size_t,double> sample() {
+			std::uniform_int_distribution<std::size_t> choose(0,probability.size()-1);
+			std::uniform_real_distribution<double> u(0.0,1.0);
+			std::size_t i = choose(rng);
+			if (u(rng) >= threshold[i]) i = alias[i];
+			return std::make_tuple(i,probability[i]);
+		}
+
+		Sampler(const RNG& r, std::vector<double>&& p) :
+				rng(r), probability(std::move(p)), threshold(probability.size()), alias(probability.size()) {
+			const std::size_t n = probability.size();
+			std::vector<std::size_t> small, large;
+			for (std::size_t i = 0; i<n; ++i) {
+				threshold[i] = probability[i]*double(n); alias[i] = i;
+				if (threshold[i]<1.0) small.push_back(i); else large.push_back(i);
+			}
+			while (!small.empty() && !large.empty()) {
+				std::size_t l = small.back(); small.pop_back();
+				std::size_t g = large.back();
+				alias[l] = g;
+				threshold[g] = (threshold[g] + threshold[l]) - 1.0;
+				if (threshold[g]<1.0) { large.pop_back(); small.push_back(g); }
+			}
+			//Whatever is left has probability 1 (up to rounding)
+			for (std::size_t i : small) threshold[i] = 1.0;
+			for (std::size_t i : large) threshold[i] = 1.0;
+		}
+		Sampler() {} //This makes things easier although I don't like it
+
+		//Checkpointing (see checkpoint.h): the alias table is stored as is instead of being rebuilt
+		template<typename Out>
+		void save(Out& out) const { out.write(rng); out.write(probability); out.write(threshold); out.write(alias); }
+		template<typename In>
+		void load(In& in) { in.read(rng); in.read(probability); in.read(threshold); in.read(alias); }
+	};
+
+public:
+	//Any container with size() and operator[] (elements can also be pointers)
+	template<typename V>
+	Sampler operator()(const V& v) const {
+		std::vector<double> p(v.size());
+		double total = 0;
+		for (std::size_t i = 0; i<v.size(); ++i) total += (p[i] = std::max(0.0,double(weight(detail::vector_element(v[i])))));
+		double mixture = (total>0.0)?uniform_mixture:1.0;
+		for (double& pi : p) pi = (1.0-mixture)*((total>0.0)?(pi/total):0.0) + mixture/double(v.size());
+		std::uniform_int_distribution<std::size_t> choose(0,10000000);
+		return Sampler(RNG(choose(rng)),std::move(p));
+	}
+
+	template<typename Out>
+	void save(Out& out) const { out.write(rng); }
+	template<typename In>
+	void load(In& in) { in.read(rng); }
+
+	//See reseed.h. Not available when the generator is a reference, as copies of the sampler share it
+	template<typename R = RNG, typename = std::enable_if_t<!std::is_reference_v<R>>>
+	void reseed(std::uint64_t seed) { rng.seed(seed); }
+
+    VectorSamplerWeighted(RNG&& r, Weight&& w, double uniform_mixture) :
+		rng(std::forward<RNG>(r)), weight(std::forward<Weight>(w)), uniform_mixture(uniform_mixture) { }
+};
+
+template<typename RNG, typename Weight, typename = std::enable_if_t<!std::is_integral_v<std::decay_t<RNG>>>>
+auto vector_sampler_weighted(Weight&& weight, RNG&& rng, double uniform_mixture = 0.1) {
+    return VectorSamplerWeighted<std::decay_t<RNG>,std::decay_t<Weight>>(
+		std::decay_t<RNG>(std::forward<RNG>(rng)),std::decay_t<Weight>(std::forward<Weight>(weight)),uniform_mixture);
+}
+
+template<typename Weight>
+auto vector_sampler_weighted(Weight&& weight, std::size_t seed = std::random_device()(), double uniform_mixture = 0.1) {
+    return vector_sampler_weighted(std::forward<Weight>(weight),std::mt19937_64(seed),uniform_mixture);
+}
+
+//Regions are chosen proportionally to their error estimation (as given by error, for instance error_single_dimension_standard())
+template<typename Error>
+auto vector_sampler_error(Error&& error, std::size_t seed = std::random_device()(), double uniform_mixture = 0.1) {
+    return vector_sampler_weighted([error] (const auto& region) { return std::get<0>(error(region)); },seed,uniform_mixture);
+}
+
+//Regions are chosen proportionally to their volume
+auto vector_sampler_volume(std::size_t seed = std::random_device()(), double uniform_mixture = 0.0) {
+    return vector_sampler_weighted([] (const auto& region) { return region.range().volume(); },seed,uniform_mixture);
+}
+
 }
 
 
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <type_traits>
+#include <utility>
+#include "../multiarray/multiarray.h"
+#include "polynomial.h"
+#include "range.h"
+
+namespace viltrum {
+
+/**
+ * Flat evaluator of a tensor product polynomial (as returned by Region::polynomial()). The coefficients are stored
+ * contiguously (first dimension changing faster) and evaluated with nested Horner schemes unrolled on SIZE and DIM,
+ * without any allocation. It gives the same values as the approximation_at of the region, but much faster, so it is
+ * meant for the residual sampling of the control variates, where the approximation is evaluated for every sample.
+ * It can be evaluated point by point or in batches (through evaluate_batch, see batch.h).
+ **/
+template<typename T, typename Float, std::size_t SIZE, std::size_t DIM>
+class TensorHorner {
+    static constexpr std::size_t power(std::size_t d) { return (d==0)?1:SIZE*power(d-1); }
+    detail::multiarray_storage<T,power(DIM)> coefficients;
+    std::array<Float,DIM> offset, scale;
+
+    //Horner on dimension D of the polynomials on dimensions 0..D-1 starting at c
+    template<std::size_t D>
+    T eval(const T* c, const std::array<Float,DIM>& t) const {
+        if constexpr (D==0) {
+            T r = c[SIZE-1];
+            for (std::size_t i = SIZE-1; i>0; --i) r = c[i-1] + t[0]*r;
+            return r;
+        } else {
+            constexpr std::size_t stride = power(D);
+            T r = eval<D-1>(c + (SIZE-1)*stride,t);
+            for (std::size_t i = SIZE-1; i>0; --i) r = eval<D-1>(c + (i-1)*stride,t) + t[D]*r;
+            return r;
+        }
+    }
+
+public:
+    using value_type = T;
+    static constexpr std::size_t dimensions = DIM;
+
+    TensorHorner(const Polynomial<T,Float,SIZE,DIM>& p) {
+        const T* c = p.coefficients().raw_data();
+        std::copy(c,c+power(DIM),coefficients.values.begin());
+        for (std::size_t i = 0; i<DIM; ++i) {
+            offset[i] = p.range().min(i);
+            scale[i] = Float(1)/(p.range().max(i) - p.range().min(i));
+        }
+    }
+
+    T operator()(const std::array<Float,DIM>& x) const {
+        std::array<Float,DIM> t;
+        for (std::size_t i = 0; i<DIM; ++i) t[i] = (x[i] - offset[i])*scale[i];
+        return eval<DIM-1>(coefficients.values.data(),t);
+    }
+
+    void evaluate_batch(const std::vector<std::array<Float,DIM>>& points, std::vector<T>& values) const {
+        values.resize(points.size());
+        for (std::size_t j = 0; j<points.size(); ++j) values[j] = (*this)(points[j]);
+    }
+};
+
+template<typename T, typename Float, std::size_t SIZE, std::size_t DIM>
+TensorHorner<T,Float,SIZE,DIM> tensor_horner(const Polynomial<T,Float,SIZE,DIM>& p) {
+    return TensorHorner<T,Float,SIZE,DIM>(p);
+}
+
+template<typename R, typename = void>
+struct has_polynomial : std::false_type {};
+
+template<typename R>
+struct has_polynomial<R,std::void_t<decltype(std::declval<const R&>().polynomial())>> : std::true_type {};
+
+namespace detail {
+template<typename R, bool = has_polynomial<R>::value>
+struct approximation_evaluator { using type = char; };
+
+template<typename R>
+struct approximation_evaluator<R,true> { using type = decltype(tensor_horner(std::declval<const R&>().polynomial())); };
+}
+
+/**
+ * Approximations of all the regions of a vector, evaluated as approximations(regions,i,x) instead of
+ * regions[i].approximation_at(x). Regions with a tensor product polynomial are evaluated through a TensorHorner built
+ * on construction, and the rest (which already have fast approximations, such as RegionGenzMalik or RegionSparseGrid)
+ * through their approximation_at. It should be rebuilt whenever the regions change.
+ **/
+template<typename R>
+class ApproximationCache {
+    static constexpr bool tensor = has_polynomial<R>::value;
+    std::vector<typename detail::approximation_evaluator<R>::type> evaluators;
+public:
+    ApproximationCache() { }
+
+    template<typename Regions>
+    ApproximationCache(const Regions& regions) {
+        if constexpr (tensor) {
+            evaluators.reserve(regions.size());
+            for (const auto& r : regions) evaluators.push_back(tensor_horner(r.polynomial()));
+        }
+    }
+
+    template<typename Regions, typename X>
+    typename R::value_type operator()(const Regions& regions, std::size_t i, const X& x) const {
+        if constexpr (tensor) return evaluators[i](x);
+        else return regions[i].approximation_at(x);
+    }
+};
+
+template<typename Regions>
+ApproximationCache<typename Regions::value_type> approximation_cache(const Regions& regions) {
+    return ApproximationCache<typename Regions::value_type>(regions);
+}
+
+}
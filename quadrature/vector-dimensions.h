@@ -28,7 +28,7 @@ public:
         data.resize(elements, t);
     }
     
-    vector_dimensions(const std::array<std::size_t, DIMBINS>& r, const std::vector<T>& e) : res(r),data(e) {
+    vector_dimensions(const std::array<std::size_t, DIMBINS>& r, const std::vector<T>& e) : data(e),res(r) {
         std::size_t elements(1);
         for (auto r : res) elements*=r;
         data.resize(elements);
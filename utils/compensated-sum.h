@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+
+namespace viltrum {
+
+/**
+ * Running sum with error compensation, so that long sequences of additions and subtractions (such as replacing the
+ * contribution of a region by those of its subregions) do not accumulate rounding error. Floating point values use
+ * Neumaier's variant of Kahan summation, which is also accurate when the term is larger than the sum. Other types
+ * (vectors, colors...) use plain Kahan summation, which only needs + and -.
+ **/
+template<typename T>
+class CompensatedSum {
+    T sum;
+    T compensation;
+public:
+    CompensatedSum() : sum(0), compensation(0) { }
+    explicit CompensatedSum(const T& t) : sum(t), compensation(0) { }
+
+    CompensatedSum& operator+=(const T& x) {
+        if constexpr (std::is_floating_point_v<T>) {
+            T t = sum + x;
+            if (std::abs(sum) >= std::abs(x)) compensation += (sum - t) + x;
+            else compensation += (x - t) + sum;
+            sum = t;
+        } else {
+            T y = x - compensation;
+            T t = sum + y;
+            compensation = (t - sum) - y;
+            sum = t;
+        }
+        return (*this);
+    }
+
+    CompensatedSum& operator-=(const T& x) {
+        if constexpr (std::is_floating_point_v<T>) return (*this) += (-x);
+        else return (*this) += (T(0) - x);
+    }
+
+    T value() const {
+        if constexpr (std::is_floating_point_v<T>) return sum + compensation;
+        else return sum;
+    }
+
+    //Checkpointing (see quadrature/checkpoint.h): the compensation is kept so a restored sum continues exactly
+    template<typename Out>
+    void save(Out& out) const { out.write(sum); out.write(compensation); }
+    template<typename In>
+    void load(In& in) { in.read(sum); in.read(compensation); }
+};
+
+}
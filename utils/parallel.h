@@ -0,0 +1,131 @@
+#pragma once
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace viltrum {
+
+/**
+ * Default number of threads for parallel integrators and steppers (all hardware threads available).
+ **/
+inline std::size_t default_threads() {
+    std::size_t n = std::thread::hardware_concurrency();
+    return (n==0)?1:n;
+}
+
+/**
+ * Threads kept alive between calls to parallel_for, so steppers that call it on every step (with little work each
+ * time) do not pay for creating and joining threads on each call. run(n,job) calls job(t) for t in [1,n) on threads
+ * of the pool (created the first time they are needed) and job(0) on the calling thread, and returns when all of
+ * them finish. It only runs one job at a time: it returns false without running anything if the pool is busy with
+ * another caller or if called from within a job.
+ **/
+class ThreadPool {
+    std::mutex busy; //Held by the caller of run
+    std::mutex mutex;
+    std::condition_variable wake, finished;
+    std::vector<std::thread> workers;
+    const std::function<void(std::size_t)>* job = nullptr;
+    std::size_t participants = 0, pending = 0;
+    std::uint64_t generation = 0;
+    bool stopping = false;
+
+    static bool& inside_job() { thread_local bool inside = false; return inside; }
+
+    void work(std::size_t index) {
+        inside_job() = true;
+        std::uint64_t done = 0;
+        for (;;) {
+            const std::function<void(std::size_t)>* current;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || ((generation != done) && (index < participants)); });
+                if (stopping) return;
+                done = generation; current = job;
+            }
+            (*current)(index);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) finished.notify_one();
+        }
+    }
+
+public:
+    //Whether the calling thread is running a job of a pool
+    static bool in_job() { return inside_job(); }
+
+    ThreadPool() = default;
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    bool run(std::size_t n, const std::function<void(std::size_t)>& f) {
+        if (inside_job()) return false;
+        std::unique_lock<std::mutex> owner(busy, std::try_to_lock);
+        if (!owner.owns_lock()) return false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (workers.size()+1 < n) workers.emplace_back(&ThreadPool::work,this,workers.size()+1);
+            job = &f; participants = n; pending = n-1; ++generation;
+        }
+        wake.notify_all();
+        inside_job() = true;
+        f(0);
+        inside_job() = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&] { return pending == 0; });
+        return true;
+    }
+
+    ~ThreadPool() {
+        { std::lock_guard<std::mutex> lock(mutex); stopping = true; }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    //Shared by all the parallel integrators and steppers
+    static ThreadPool& global() { static ThreadPool pool; return pool; }
+};
+
+/**
+ * Calls f(i,thread) for every i in [0,n). Indices are handed dynamically to nthreads threads (the calling thread
+ * being one of them), so which thread processes which index is not deterministic: anything that should be
+ * reproducible must depend on i and not on thread. The thread parameter (in [0,nthreads)) is meant for per-thread
+ * scratch buffers. The first exception thrown by f is rethrown on the calling thread once all threads finish.
+ * The threads come from ThreadPool::global(). Calls from within f run on the calling thread only, and calls while
+ * the pool is busy with another thread start threads of their own.
+ **/
+template<typename F>
+void parallel_for(std::size_t n, const F& f, std::size_t nthreads = default_threads()) {
+    nthreads = std::max(std::size_t(1),std::min(nthreads,n));
+    if (nthreads == 1) {
+        for (std::size_t i = 0; i<n; ++i) f(i,std::size_t(0));
+        return;
+    }
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr exception;
+    std::mutex exception_mutex;
+    std::function<void(std::size_t)> worker = [&] (std::size_t thread) {
+        try {
+            for (std::size_t i = next++; i<n; i = next++) f(i,thread);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(exception_mutex);
+            if (!exception) exception = std::current_exception();
+            next = n; //Other threads stop as soon as they finish their current index
+        }
+    };
+    if (ThreadPool::in_job()) worker(0); //The other threads are already busy with the enclosing call
+    else if (!ThreadPool::global().run(nthreads,worker)) {
+        std::vector<std::thread> threads; threads.reserve(nthreads-1);
+        for (std::size_t t = 1; t<nthreads; ++t) threads.emplace_back(worker,t);
+        worker(0);
+        for (auto& t : threads) t.join();
+    }
+    if (exception) std::rethrow_exception(exception);
+}
+
+}
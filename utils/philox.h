@@ -0,0 +1,100 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+namespace viltrum {
+
+/**
+ * Philox4x32-10 counter-based random number generator (Salmon et al. 2011). Each output block is a pure function of
+ * the key (the seed) and a 128 bit counter, half of which is the stream index and half the position within the
+ * stream. Therefore any stream (for instance, one per pixel) can be started in O(1) from (seed, stream), without
+ * sharing any state, and the generator state is just a few words. It satisfies UniformRandomBitGenerator so it
+ * can be used with the standard distributions.
+ **/
+class Philox {
+    std::uint64_t key;
+    std::uint64_t stream;
+    std::uint64_t counter;
+    std::array<std::uint64_t,2> buffer;
+    std::size_t next;
+
+    static void mulhilo(std::uint32_t a, std::uint32_t b, std::uint32_t& hi, std::uint32_t& lo) {
+        std::uint64_t p = std::uint64_t(a)*std::uint64_t(b);
+        hi = std::uint32_t(p >> 32); lo = std::uint32_t(p);
+    }
+
+public:
+    using result_type = std::uint64_t;
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return ~result_type(0); }
+
+    //The 128 random bits of block number c of stream s with key k
+    static std::array<std::uint64_t,2> block(std::uint64_t k, std::uint64_t s, std::uint64_t c) {
+        std::array<std::uint32_t,4> x{std::uint32_t(c),std::uint32_t(c>>32),std::uint32_t(s),std::uint32_t(s>>32)};
+        std::uint32_t k0 = std::uint32_t(k), k1 = std::uint32_t(k>>32);
+        for (int round = 0; round<10; ++round) {
+            std::uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u,x[0],hi0,lo0);
+            mulhilo(0xCD9E8D57u,x[2],hi1,lo1);
+            x = {hi1^x[1]^k0, lo1, hi0^x[3]^k1, lo0};
+            k0 += 0x9E3779B9u; k1 += 0xBB67AE85u;
+        }
+        return {(std::uint64_t(x[1])<<32) | x[0], (std::uint64_t(x[3])<<32) | x[2]};
+    }
+
+    Philox(std::uint64_t seed = 0, std::uint64_t stream = 0) : key(seed), stream(stream), counter(0), next(2) { }
+
+    result_type operator()() {
+        if (next == 2) { buffer = block(key,stream,counter++); next = 0; }
+        return buffer[next++];
+    }
+
+    //Uniform number in [0,1) from 64 random bits (as many bits as the mantissa holds)
+    template<typename Float>
+    static Float canonical(std::uint64_t bits) {
+        if constexpr (sizeof(Float) <= sizeof(float)) return Float(bits >> 40)*Float(0x1.0p-24);
+        else return Float(bits >> 11)*Float(0x1.0p-53);
+    }
+
+    /**
+     * Uniform point in [0,1)^DIM of sample index of stream s with key k, computed directly from the counter (two
+     * dimensions per block), so samples can be generated in any order or in parallel.
+     **/
+    template<typename Float, std::size_t DIM>
+    static std::array<Float,DIM> uniform(std::uint64_t k, std::uint64_t s, std::uint64_t index) {
+        constexpr std::uint64_t blocks = (DIM+1)/2;
+        std::array<Float,DIM> u;
+        for (std::size_t b = 0; b<blocks; ++b) {
+            auto r = block(k,s,index*blocks+b);
+            u[2*b] = canonical<Float>(r[0]);
+            if (2*b+1 < DIM) u[2*b+1] = canonical<Float>(r[1]);
+        }
+        return u;
+    }
+
+    //Next uniform point in [0,1)^DIM of this stream (one output per dimension)
+    template<typename Float, std::size_t DIM>
+    std::array<Float,DIM> uniform() {
+        std::array<Float,DIM> u;
+        for (std::size_t i = 0; i<DIM; ++i) u[i] = canonical<Float>((*this)());
+        return u;
+    }
+
+    //Restarts the current stream with a different key
+    void seed(std::uint64_t s) { key = s; counter = 0; next = 2; }
+
+    //Skips n outputs in O(1)
+    void discard(unsigned long long n) {
+        while ((n>0) && (next<2)) { ++next; --n; }
+        counter += n/2;
+        if (n%2) { buffer = block(key,stream,counter++); next = 1; }
+    }
+
+    bool operator==(const Philox& that) const {
+        return (key==that.key) && (stream==that.stream) && (counter==that.counter) && (next==that.next);
+    }
+    bool operator!=(const Philox& that) const { return !((*this)==that); }
+};
+
+}
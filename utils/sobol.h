@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+
+namespace viltrum {
+
+/**
+ * Owen-scrambled Sobol sequence (hash-based nested uniform scrambling, Burley 2020). The first dimensions come from
+ * the Sobol direction numbers of Joe and Kuo; dimensions beyond them reuse the table with the point index shuffled
+ * independently for each group of dimensions ("padding"), which keeps each group well stratified. Points are a pure
+ * function of (index, seed): different seeds give independent randomizations of the same low-discrepancy set.
+ **/
+class Sobol {
+public:
+    static constexpr std::size_t table_dimensions = 16;
+
+private:
+    using Directions = std::array<std::array<std::uint32_t,32>,table_dimensions>;
+
+    static const Directions& directions() {
+        // s (degree), a (coefficients) and m (initial numbers) of dimensions 2..16 (new-joe-kuo-6.21201)
+        static const std::uint32_t s[table_dimensions-1] = {1,2,3,3,4,4,5,5,5,5,5,5,6,6,6};
+        static const std::uint32_t a[table_dimensions-1] = {0,1,1,2,1,4,2,4,7,11,13,14,1,13,16};
+        static const std::uint32_t m[table_dimensions-1][6] = {
+            {1}, {1,3}, {1,3,1}, {1,1,1}, {1,1,3,3}, {1,3,5,13}, {1,1,5,5,17}, {1,1,5,5,5}, {1,1,7,11,19},
+            {1,1,5,1,1}, {1,1,1,3,11}, {1,3,5,5,31}, {1,3,3,9,7,49}, {1,1,1,15,21,21}, {1,3,1,13,27,49} };
+        static const Directions v = [] () {
+            Directions v;
+            for (std::uint32_t k = 0; k<32; ++k) v[0][k] = std::uint32_t(1) << (31-k);
+            for (std::size_t d = 1; d<table_dimensions; ++d) {
+                const std::uint32_t sd = s[d-1], ad = a[d-1];
+                for (std::uint32_t k = 0; k<32; ++k) {
+                    if (k<sd) v[d][k] = m[d-1][k] << (31-k);
+                    else {
+                        v[d][k] = v[d][k-sd] ^ (v[d][k-sd] >> sd);
+                        for (std::uint32_t j = 1; j<sd; ++j)
+                            if ((ad >> (sd-1-j)) & 1) v[d][k] ^= v[d][k-j];
+                    }
+                }
+            }
+            return v;
+        }();
+        return v;
+    }
+
+    static std::uint32_t reverse_bits(std::uint32_t x) {
+        x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+        x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+        x = ((x >> 4) & 0x0F0F0F0Fu) | ((x & 0x0F0F0F0Fu) << 4);
+        x = ((x >> 8) & 0x00FF00FFu) | ((x & 0x00FF00FFu) << 8);
+        return (x >> 16) | (x << 16);
+    }
+
+    static std::uint32_t hash(std::uint32_t x) {
+        x ^= x >> 16; x *= 0x21f0aaadu;
+        x ^= x >> 15; x *= 0xd35a2d97u;
+        x ^= x >> 15;
+        return x;
+    }
+
+    static std::uint32_t hash_combine(std::uint32_t seed, std::uint32_t v) {
+        return seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+    }
+
+public:
+    //Unscrambled Sobol value (32 bits) of point index in dimension d < table_dimensions
+    static std::uint32_t sample(std::uint32_t index, std::size_t d) {
+        const auto& v = directions()[d];
+        std::uint32_t x = 0;
+        for (std::uint32_t k = 0; index; index >>= 1, ++k) if (index & 1) x ^= v[k];
+        return x;
+    }
+
+    //Owen scrambling of the bits of x (from the most significant one) keyed on seed (Laine-Karras style hash)
+    static std::uint32_t nested_uniform_scramble(std::uint32_t x, std::uint32_t seed) {
+        x = reverse_bits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverse_bits(x);
+    }
+
+    //Point index of the Owen-scrambled Sobol sequence with the given seed, in [0,1)^DIM
+    template<typename Float, std::size_t DIM>
+    static std::array<Float,DIM> uniform(std::uint32_t index, std::uint64_t seed) {
+        std::array<Float,DIM> u;
+        const std::uint32_t s = hash(std::uint32_t(seed) ^ hash(std::uint32_t(seed >> 32)));
+        for (std::size_t group = 0; group*table_dimensions < DIM; ++group) {
+            std::uint32_t i = nested_uniform_scramble(index, hash_combine(s,hash(std::uint32_t(2*group))));
+            for (std::size_t d = group*table_dimensions; (d<DIM) && (d<(group+1)*table_dimensions); ++d) {
+                std::uint32_t x = nested_uniform_scramble(sample(i,d-group*table_dimensions), hash_combine(s,hash(std::uint32_t(2*d+1))));
+                if constexpr (sizeof(Float) <= sizeof(float)) u[d] = Float(x >> 8)*Float(0x1.0p-24);
+                else u[d] = Float(x)*Float(0x1.0p-32);
+            }
+        }
+        return u;
+    }
+};
+
+}
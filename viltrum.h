@@ -1,25 +1,46 @@
 #pragma once
 
+#include "quadrature/batch.h"
+#include "quadrature/bin-index.h"
 #include "quadrature/control-variates.h"
 #include "quadrature/error.h"
+#include "quadrature/genz-malik.h"
 #include "quadrature/integrate.h"
 #include "quadrature/integrate-adaptive-control-variates.h"
 #include "quadrature/integrate-adaptive-control-variates-precalculate.h"
+#include "quadrature/integrate-adaptive-parallel.h"
+#include "quadrature/integrate-adaptive-pool.h"
 #include "quadrature/integrate-bins.h"
 #include "quadrature/integrate-bins-adaptive.h"
 #include "quadrature/integrate-bins-adaptive-precalculate.h"
+#include "quadrature/integrate-bins-parallel.h"
 #include "quadrature/integrate-bins-stepper.h"
+#include "quadrature/integrate-bins-tiled.h"
+#include "quadrature/integrate-budget.h"
 #include "quadrature/integrate-optimized-adaptive-stratified-control-variates.h"
 #include "quadrature/monte-carlo.h"
 #include "quadrature/multidimensional-range.h"
 #include "quadrature/munoz2014.h"
 #include "quadrature/nested.h"
+#include "quadrature/node-cache.h"
 #include "quadrature/polynomial.h"
+#include "quadrature/quasi-monte-carlo.h"
+#include "quadrature/random.h"
 #include "quadrature/range.h"
+#include "quadrature/region-pool.h"
 #include "quadrature/region.h"
+#include "quadrature/region-per-dimension.h"
+#include "quadrature/region-tree.h"
+#include "quadrature/reseed.h"
 #include "quadrature/rules.h"
+#include "quadrature/sparse-grid.h"
 #include "quadrature/sample-vector.h"
+#include "quadrature/tensor-horner.h"
 #include "quadrature/vector-dimensions.h"
 #include "quadrature/bins-containers-adaptor.h"
+#include "quadrature/checkpoint.h"
 
 #include "utils/function-wrapper.h"
+#include "utils/parallel.h"
+#include "utils/philox.h"
+#include "utils/sobol.h"